@@ -1,190 +1,587 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
 #include <fstream>  // For file handling
 #include <cmath>    // For distance calculation
-#include <sstream>  // For parsing the file
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <csignal>
+#include <string>
+#include "checkpoint_file.h"
+#include "random_streams.h"
+#include "thread_pool.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
-// Define possible states for an agent
-enum State { Susceptible, Infected, Recovered, Vaccinated, Quarantined };
+namespace abm {
 
-// Agent class representing individuals
-class Agent {
+// Define possible states for an agent (stored as one byte per agent)
+enum State : uint8_t { Susceptible, Infected, Recovered, Vaccinated, Quarantined };
+
+// Structure-of-arrays storage for all agents. Each attribute lives in its own contiguous
+// array so a pass over the population only pulls the fields it actually reads.
+class AgentStore {
 public:
-    State state;            // State of the agent
-    int x, y;               // Position on the grid
-    int days_infected;      // Days the agent has been infected or quarantined
-    int quarantine_duration; // Duration in steps for quarantine
-
-    // Constructor
-    Agent(int x, int y, State state) : x(x), y(y), state(state), days_infected(0), quarantine_duration(5) {}
-
-    // Random movement (up, down, left, right)
-    void move(int grid_size) {
-        if (state != Quarantined) {  // Quarantined agents don't move
-            int direction = rand() % 4;
-            if (direction == 0 && x > 0) x--;
-            else if (direction == 1 && x < grid_size - 1) x++;
-            else if (direction == 2 && y > 0) y--;
-            else if (direction == 3 && y < grid_size - 1) y++;
+    vector<int> x, y;                 // Positions on the grid
+    vector<State> state;              // State of each agent
+    vector<uint16_t> days_infected;   // Days each agent has been infected or quarantined
+
+    size_t size() const { return state.size(); }
+
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+        state.resize(n);
+        days_infected.resize(n);
+    }
+
+    // Movement in the given direction (0-3: left, right, up, down)
+    void move(size_t i, int grid_size, int direction) {
+        if (state[i] != Quarantined) {  // Quarantined agents don't move
+            if (direction == 0 && x[i] > 0) x[i]--;
+            else if (direction == 1 && x[i] < grid_size - 1) x[i]++;
+            else if (direction == 2 && y[i] > 0) y[i]--;
+            else if (direction == 3 && y[i] < grid_size - 1) y[i]++;
         }
     }
 
-    // Update infected days
-    void update_days() {
-        if (state == Infected || state == Quarantined) {
-            days_infected++;
+    // Update infected days (saturates instead of wrapping on very long runs)
+    void update_days(size_t i) {
+        if ((state[i] == Infected || state[i] == Quarantined) && days_infected[i] < UINT16_MAX) {
+            days_infected[i]++;
         }
     }
 };
 
+// Purposes that separate the independent random streams of each agent
+enum RandomPurpose { PlacementXDraw, PlacementYDraw, VaccinationDraw, MovementDraw, InfectionDraw, TransitionDraw, CampaignDraw };
+
 // Check if two agents are in contact (within a certain distance)
-bool is_in_contact(const Agent& a1, const Agent& a2, int infection_radius) {
-    int dx = a1.x - a2.x;
-    int dy = a1.y - a2.y;
-    return (dx * dx + dy * dy <= infection_radius * infection_radius);  // Euclidean distance check
+bool is_in_contact(const AgentStore& agents, size_t a, size_t b, int infection_radius) {
+    int64_t dx = agents.x[a] - agents.x[b];
+    int64_t dy = agents.y[a] - agents.y[b];
+    int64_t r = infection_radius;
+    return (dx * dx + dy * dy <= r * r);  // Euclidean distance check, in 64 bits so large grids cannot overflow
 }
 
-// Save results to CSV
-void save_to_csv(int step, int susceptible_count, int infected_count, int recovered_count, int vaccinated_count, int quarantined_count, ofstream& file) {
-    file << step << "," << susceptible_count << "," << infected_count << "," << recovered_count << "," << vaccinated_count << "," << quarantined_count << endl;
-}
+// Uniform grid that buckets agents by cell so contact checks only visit neighboring cells.
+// Cells are at least as wide as the infection radius, so every possible contact lies in the
+// 3x3 block of cells around an infector. On a sparse grid they are widened to hold about one
+// agent each, which keeps the cell count near the agent count however large the grid is.
+class SpatialGrid {
+public:
+    SpatialGrid(int grid_size, int infection_radius, int num_agents)
+        : cell_size(cell_size_for(grid_size, infection_radius, num_agents)),
+          cells_per_side((grid_size + cell_size - 1) / cell_size),
+          cell_start(static_cast<size_t>(cells_per_side) * cells_per_side + 1, 0) {}
+
+    // Rebuild the buckets from the current agent positions (counting sort, O(agents + cells)).
+    // Cell lookup runs on the pool; the histogram and scatter stay sequential so agents keep
+    // index order inside each cell.
+    void rebuild(const AgentStore& agents, ThreadPool& pool) {
+        agent_cell.resize(agents.size());
+        cell_agents.resize(agents.size());
+        pool.parallel_for(agents.size(), pool.default_blocks(), [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                agent_cell[i] = cell_of(agents.x[i], agents.y[i]);
+            }
+        });
+
+        fill(cell_start.begin(), cell_start.end(), 0);
+        for (size_t i = 0; i < agents.size(); ++i) {
+            cell_start[agent_cell[i] + 1]++;
+        }
+        for (size_t c = 1; c < cell_start.size(); ++c) {
+            cell_start[c] += cell_start[c - 1];
+        }
+
+        cursor.assign(cell_start.begin(), cell_start.end() - 1);
+        for (size_t i = 0; i < agents.size(); ++i) {
+            cell_agents[cursor[agent_cell[i]]++] = static_cast<int>(i);
+        }
+    }
 
-// Function to read parameters from a file
-void read_parameters(const string& filename, double& infection_prob, double& recovery_prob, double& vaccination_prob, double& quarantine_prob) {
-    ifstream file(filename);
-    string line;
-    
-    while (getline(file, line)) {
-        stringstream ss(line);
-        string param;
-        double value;
-        
-        getline(ss, param, '=');
-        ss >> value;
-        
-        if (param == "infection_prob") infection_prob = value;
-        else if (param == "recovery_prob") recovery_prob = value;
-        else if (param == "vaccination_prob") vaccination_prob = value;
-        else if (param == "quarantine_prob") quarantine_prob = value;
+    // Call visit(j) for every agent j bucketed in the cells surrounding position (x, y).
+    // Read-only, so any number of threads may search concurrently.
+    template <typename Visitor>
+    void for_each_nearby(int x, int y, Visitor visit) const {
+        int cx = x / cell_size;
+        int cy = y / cell_size;
+        for (int ny = max(cy - 1, 0); ny <= min(cy + 1, cells_per_side - 1); ++ny) {
+            for (int nx = max(cx - 1, 0); nx <= min(cx + 1, cells_per_side - 1); ++nx) {
+                int cell = ny * cells_per_side + nx;
+                for (int k = cell_start[cell]; k < cell_start[cell + 1]; ++k) {
+                    visit(cell_agents[k]);
+                }
+            }
+        }
     }
-}
 
-// Simulation function
-void abm_simulation(int num_agents, int grid_size, double infection_prob, double recovery_prob, double vaccination_prob, double quarantine_prob, int infection_radius, int total_steps) {
-    vector<Agent> agents;  // Store all agents
-    srand(static_cast<unsigned>(time(0)));  // Random seed
+private:
+    int cell_size;
+    int cells_per_side;
+    vector<int> cell_start;   // Offset of each cell's first agent in cell_agents
+    vector<int> cell_agents;  // Agent indices grouped by cell
+    vector<int> agent_cell;   // Cell of each agent from the last rebuild
+    vector<int> cursor;       // Scratch write positions used while rebuilding
 
-    // Open file to write results
-    ofstream file("ABM_simulation_results.csv");
-    file << "Step,Susceptible,Infected,Recovered,Vaccinated,Quarantined" << endl;
+    static int cell_size_for(int grid_size, int infection_radius, int num_agents) {
+        int per_side = static_cast<int>(ceil(sqrt(static_cast<double>(max(num_agents, 1)))));
+        int sparse = (grid_size + per_side - 1) / per_side;
+        return max(max(infection_radius, 1), sparse);
+    }
 
-    // Initialize agents
-    for (int i = 0; i < num_agents; ++i) {
-        int x = rand() % grid_size;
-        int y = rand() % grid_size;
-        State state = (i == 0) ? Infected : (static_cast<double>(rand()) / RAND_MAX < vaccination_prob ? Vaccinated : Susceptible);
-        agents.push_back(Agent(x, y, state));
+    int cell_of(int x, int y) const {
+        return (y / cell_size) * cells_per_side + (x / cell_size);
     }
+};
+
+// Population counts per state
+struct StateCounts {
+    int susceptible, infected, recovered, vaccinated, quarantined;
+};
+
+// Parallel step engine. Agents are partitioned into contiguous blocks on a thread pool, every
+// random draw is keyed by (seed, agent, step, purpose) and each phase only writes to the agent
+// it is processing, so a run is bit-identical for a given seed regardless of thread count.
+class AbmEngine {
+public:
+    AbmEngine(const AbmParameters& params, ThreadPool& pool)
+        : params(params), pool(pool), grid(params.grid_size, params.infection_radius, params.num_agents), step_index(0) {}
+
+    const AgentStore& population() const { return agents; }
+    uint64_t steps_done() const { return step_index; }
+
+    // Place agents uniformly at random; agent 0 starts infected
+    void initialize() {
+        agents.resize(params.num_agents);
+        newly_infected.assign(params.num_agents, 0);
+        for_each_block([&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                agents.x[i] = random_index(i, PlacementXDraw, params.grid_size);
+                agents.y[i] = random_index(i, PlacementYDraw, params.grid_size);
+                agents.state[i] = (i == 0) ? Infected : (random(i, VaccinationDraw) < params.vaccination_prob ? Vaccinated : Susceptible);
+                agents.days_infected[i] = 0;
+            }
+        });
+        step_index = 0;
+    }
+
+    // Continue from a saved population after the given number of steps. Draws are keyed by the
+    // step, so this needs no random state beyond the seed.
+    void restore(const AgentStore& saved, uint64_t steps) {
+        agents = saved;
+        newly_infected.assign(agents.size(), 0);
+        step_index = steps;
+    }
+
+    // Vaccinate each susceptible agent with the given probability, as a campaign at the current step
+    void vaccinate(double vaccination_prob) {
+        for_each_block([&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                if (agents.state[i] == Susceptible && random(i, CampaignDraw) < vaccination_prob) agents.state[i] = Vaccinated;
+            }
+        });
+    }
+
+    // Advance the population by one step and return the resulting counts
+    StateCounts step() {
+        ++step_index;
 
-    // Simulation loop
-    for (int step = 0; step < total_steps; ++step) {
         // Move agents
-        for (size_t i = 0; i < agents.size(); ++i) {
-            agents[i].move(grid_size);
-            agents[i].update_days(); // Update the number of days infected or quarantined
-        }
+        for_each_block([&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                agents.move(i, params.grid_size, random_index(i, MovementDraw, 4));
+                agents.update_days(i); // Update the number of days infected or quarantined
+            }
+        });
 
-        // Infection spread and recovery logic
-        for (size_t i = 0; i < agents.size(); ++i) {
-            Agent& infector = agents[i];
-            if (infector.state == Infected) {
-                for (size_t j = 0; j < agents.size(); ++j) {
-                    Agent& susceptible = agents[j];
-                    if (susceptible.state == Susceptible && is_in_contact(infector, susceptible, infection_radius)) {
-                        double r = static_cast<double>(rand()) / RAND_MAX;
-                        if (r < infection_prob) {
-                            susceptible.state = Infected;
-                        }
+        // Re-bucket agents after movement so contact search only touches neighboring cells
+        grid.rebuild(agents, pool);
+
+        // Infection spread: each susceptible pulls from the infected agents around it and escapes
+        // each contact independently, so only its own flag is written
+        double escape_prob = 1.0 - params.infection_prob;
+        int radius = params.infection_radius;
+        for_each_block([&](size_t begin, size_t end, size_t) {
+            for (size_t j = begin; j < end; ++j) {
+                if (agents.state[j] != Susceptible) continue;
+                double escape = 1.0;
+                grid.for_each_nearby(agents.x[j], agents.y[j], [&](int i) {
+                    if (agents.state[i] == Infected && is_in_contact(agents, i, j, radius)) {
+                        escape *= escape_prob;
                     }
-                }
+                });
+                newly_infected[j] = (escape < 1.0 && random(j, InfectionDraw) < 1.0 - escape);
             }
-        }
+        });
 
         // Recovery and quarantine logic
-        for (size_t i = 0; i < agents.size(); ++i) {
-            Agent& agent = agents[i];
-            if (agent.state == Infected) {
-                double r = static_cast<double>(rand()) / RAND_MAX;
-                if (r < recovery_prob) {
-                    agent.state = Recovered;
-                } else if (r < quarantine_prob) {
-                    agent.state = Quarantined;
-                    agent.days_infected = 0; // Reset days in infected status when quarantined
+        vector<StateCounts> block_counts(block_count(), StateCounts());
+        for_each_block([&](size_t begin, size_t end, size_t block) {
+            StateCounts& counts = block_counts[block];
+            for (size_t i = begin; i < end; ++i) {
+                State& state = agents.state[i];
+                if (newly_infected[i]) {
+                    state = Infected;
+                    newly_infected[i] = 0;
                 }
-            } else if (agent.state == Quarantined) {
-                // Check if the quarantine duration has passed
-                if (agent.days_infected >= agent.quarantine_duration) {
-                    agent.state = Susceptible; // Return to susceptible after quarantine
+
+                if (state == Infected) {
+                    double r = random(i, TransitionDraw);
+                    if (r < params.recovery_prob) {
+                        state = Recovered;
+                    } else if (r < params.quarantine_prob) {
+                        state = Quarantined;
+                        agents.days_infected[i] = 0; // Reset days in infected status when quarantined
+                    }
+                } else if (state == Quarantined) {
+                    // Check if the quarantine duration has passed
+                    if (agents.days_infected[i] >= params.quarantine_duration) {
+                        state = Susceptible; // Return to susceptible after quarantine
+                    }
+                } else if (state == Vaccinated) {
+                    // Allow a small probability of breakthrough infection
+                    if (random(i, TransitionDraw) < params.breakthrough_prob) { // 5% chance of breakthrough infection by default
+                        state = Infected;
+                    }
                 }
-            } else if (agent.state == Vaccinated) {
-                // Allow a small probability of breakthrough infection
-                double r = static_cast<double>(rand()) / RAND_MAX;
-                if (r < 0.05) { // 5% chance of breakthrough infection
-                    agent.state = Infected;
+
+                // Count each state
+                switch (state) {
+                    case Susceptible: counts.susceptible++; break;
+                    case Infected: counts.infected++; break;
+                    case Recovered: counts.recovered++; break;
+                    case Vaccinated: counts.vaccinated++; break;
+                    case Quarantined: counts.quarantined++; break;
                 }
             }
+        });
+
+        StateCounts total = StateCounts();
+        for (size_t b = 0; b < block_counts.size(); ++b) {
+            total.susceptible += block_counts[b].susceptible;
+            total.infected += block_counts[b].infected;
+            total.recovered += block_counts[b].recovered;
+            total.vaccinated += block_counts[b].vaccinated;
+            total.quarantined += block_counts[b].quarantined;
         }
+        return total;
+    }
 
-        // Count each state
-        int susceptible_count = 0, infected_count = 0, recovered_count = 0, vaccinated_count = 0, quarantined_count = 0;
-        for (size_t i = 0; i < agents.size(); ++i) {
-            const Agent& agent = agents[i];  // Use explicit type instead of auto
-            switch (agent.state) {
-                case Susceptible: susceptible_count++; break;
-                case Infected: infected_count++; break;
-                case Recovered: recovered_count++; break;
-                case Vaccinated: vaccinated_count++; break;
-                case Quarantined: quarantined_count++; break;
-            }
+private:
+    AbmParameters params;
+    ThreadPool& pool;
+    AgentStore agents;
+    SpatialGrid grid;
+    vector<uint8_t> newly_infected;  // Infections decided this step, applied in the next phase
+    uint64_t step_index;
+
+    size_t block_count() const { return min(pool.default_blocks(), max<size_t>(agents.size(), 1)); }
+
+    template <typename Body>
+    void for_each_block(Body body) {
+        pool.parallel_for(agents.size(), block_count(), body);
+    }
+
+    double random(size_t agent, RandomPurpose purpose) const {
+        return keyed_uniform(params.seed, agent, step_index, purpose);
+    }
+
+    int random_index(size_t agent, RandomPurpose purpose, int n) const {
+        return static_cast<int>(random(agent, purpose) * n);
+    }
+};
+
+// Save results to CSV
+void save_to_csv(int step, int susceptible_count, int infected_count, int recovered_count, int vaccinated_count, int quarantined_count, ResultSink& file) {
+    file.row(step, susceptible_count, infected_count, recovered_count, vaccinated_count, quarantined_count);
+}
+
+// Checkpoints of a run (see checkpoint_file.h). The payload holds the result parameters by
+// name, the steps done, the agent arrays and the population counts of every step so far, so a
+// resumed run writes the same results file as one that was never interrupted.
+const char checkpoint_magic[8] = {'E', 'P', 'I', 'A', 'B', 'M', 'C', '1'};
+
+struct AbmCheckpoint {
+    AbmParameters params;
+    uint64_t steps_done;
+    AgentStore agents;
+    vector<StateCounts> history;  // Counts after each step done
+};
+
+// Where and how often a run saves its state
+struct CheckpointSettings {
+    string filename;  // Empty for no checkpoints
+    int every;        // Steps between checkpoints; 0 saves only when the run is cancelled
+
+    CheckpointSettings() : every(0) {}
+};
+
+vector<unsigned char> pack_checkpoint(const AbmParameters& params, const AgentStore& agents, uint64_t steps_done,
+                                      const vector<StateCounts>& history) {
+    CheckpointBuffer buffer(checkpoint_magic);
+    uint32_t fields = 0;
+    for (const ParameterInfo& field : abm_schema) fields += !(field.flags & RunSetting);
+    buffer.put<uint32_t>(fields);
+    for (const ParameterInfo& field : abm_schema) {
+        if (field.flags & RunSetting) continue;
+        buffer.put_string(field.name);
+        buffer.put<double>(read_parameter(field, &params));
+    }
+    buffer.put<uint64_t>(steps_done);
+    buffer.put_array(agents.x);
+    buffer.put_array(agents.y);
+    buffer.put_array(agents.state);
+    buffer.put_array(agents.days_infected);
+    buffer.put_array(history);
+    return buffer.finish();
+}
+
+// Read a checkpoint. Returns false, with the reason in error, if the file is missing, damaged
+// or not an ABM checkpoint.
+bool read_checkpoint(const string& filename, AbmCheckpoint& saved, string& error) {
+    CheckpointReader reader;
+    if (!reader.open(filename, checkpoint_magic)) {
+        error = filename + " is not a complete ABM checkpoint";
+        return false;
+    }
+
+    set_defaults(abm_schema, saved.params);
+    uint32_t fields = 0;
+    reader.get(fields);
+    for (uint32_t f = 0; f < fields && reader.ok(); ++f) {
+        string name;
+        double value = 0.0;
+        reader.get_string(name);
+        reader.get(value);
+        if (reader.ok() && !assign_parameter(abm_schema, name, value, saved.params, error)) {
+            error = filename + ": " + error;
+            return false;
         }
+    }
+    reader.get(saved.steps_done);
+    reader.get_array(saved.agents.x);
+    reader.get_array(saved.agents.y);
+    reader.get_array(saved.agents.state);
+    reader.get_array(saved.agents.days_infected);
+    reader.get_array(saved.history);
+
+    size_t n = saved.params.num_agents;
+    bool consistent = reader.ok() && saved.agents.x.size() == n && saved.agents.y.size() == n &&
+                      saved.agents.state.size() == n && saved.agents.days_infected.size() == n &&
+                      saved.history.size() == saved.steps_done && saved.steps_done <= static_cast<uint64_t>(saved.params.total_steps);
+    for (size_t i = 0; consistent && i < n; ++i) consistent = saved.agents.state[i] <= Quarantined;
+    if (!consistent) {
+        error = filename + " is not a complete ABM checkpoint";
+        return false;
+    }
+    return true;
+}
+
+// Step the engine to the end of the run, writing one row per step. history holds the counts of
+// the steps the engine has already done and gains the rest. Returns false if the run was
+// cancelled; with checkpoint settings its state is then saved before returning.
+bool continue_simulation(AbmEngine& engine, const AbmParameters& params, vector<StateCounts>& history, ResultSink& file,
+                         const RunContext& context, const CheckpointSettings& checkpoint) {
+    CheckpointWriter writer;
+    auto report = [&](bool written) {
+        if (!written && context.log) *context.log << "Error: Could not write checkpoint " << checkpoint.filename << endl;
+    };
+
+    // Write results
+    file.row("Step", "Susceptible", "Infected", "Recovered", "Vaccinated", "Quarantined");
+    for (size_t step = 0; step < history.size(); ++step) {
+        const StateCounts& counts = history[step];
+        save_to_csv(static_cast<int>(step), counts.susceptible, counts.infected, counts.recovered, counts.vaccinated, counts.quarantined, file);
+    }
+
+    // Simulation loop
+    for (int step = static_cast<int>(history.size()); step < params.total_steps; ++step) {
+        StateCounts counts = engine.step();
+        history.push_back(counts);
 
         // Save the population counts for this step
-        save_to_csv(step, susceptible_count, infected_count, recovered_count, vaccinated_count, quarantined_count, file);
+        save_to_csv(step, counts.susceptible, counts.infected, counts.recovered, counts.vaccinated, counts.quarantined, file);
 
         // Display population counts (optional)
-        cout << "Step " << step << ": Susceptible = " << susceptible_count
-             << ", Infected = " << infected_count
-             << ", Recovered = " << recovered_count
-             << ", Vaccinated = " << vaccinated_count
-             << ", Quarantined = " << quarantined_count << endl;
+        if (context.log) {
+            *context.log << "Step " << step << ": Susceptible = " << counts.susceptible
+                 << ", Infected = " << counts.infected
+                 << ", Recovered = " << counts.recovered
+                 << ", Vaccinated = " << counts.vaccinated
+                 << ", Quarantined = " << counts.quarantined << endl;
+        }
+
+        bool proceed = context.proceed(static_cast<double>(step + 1) / params.total_steps);
+        bool periodic = checkpoint.every > 0 && (step + 1) % checkpoint.every == 0 && step + 1 < params.total_steps;
+        if (!checkpoint.filename.empty() && (periodic || !proceed)) {
+            // The state is copied here and written while the next steps run
+            report(writer.write(checkpoint.filename, pack_checkpoint(params, engine.population(), engine.steps_done(), history)));
+        }
+        if (!proceed) {
+            report(writer.wait());
+            return false;
+        }
     }
+    report(writer.wait());
+    return true;
+}
 
-    file.close();
+// Simulation function; returns false if the run was cancelled
+bool abm_simulation(const AbmParameters& params, ResultSink& file, const RunContext& context,
+                    const CheckpointSettings& checkpoint = CheckpointSettings()) {
+    ThreadPool pool(params.num_threads);
+    AbmEngine engine(params, pool);
+
+    // Initialize agents
+    engine.initialize();
+
+    vector<StateCounts> history;
+    return continue_simulation(engine, params, history, file, context, checkpoint);
+}
+
+// Resume a run from its checkpoint on num_threads threads. The results, including the rows of
+// the steps done before the checkpoint, are identical to those of the uninterrupted run.
+bool resume_simulation(const AbmCheckpoint& saved, int num_threads, ResultSink& file, const RunContext& context,
+                       const CheckpointSettings& checkpoint = CheckpointSettings()) {
+    AbmParameters params = saved.params;
+    params.num_threads = num_threads;
+    ThreadPool pool(params.num_threads);
+    AbmEngine engine(params, pool);
+    engine.restore(saved.agents, saved.steps_done);
+
+    vector<StateCounts> history = saved.history;
+    return continue_simulation(engine, params, history, file, context, checkpoint);
 }
 
-int main() {
-    // Simulation parameters
-    int num_agents = 100;
-    int grid_size = 20;
+// A run stopped after its fork step; branches continue copies of its state
+struct AbmFork : ForkPoint {
+    AbmCheckpoint state;
+};
+
+// Function to run the ABM to the end of step fork_step and keep its state for branches; null,
+// with the reason in error, if the parameters are invalid or the run was cancelled
+shared_ptr<const ForkPoint> fork(const ParameterSet& params, int fork_step, const RunContext& context, string& error) {
+    shared_ptr<AbmFork> point = make_shared<AbmFork>();
+    AbmCheckpoint& saved = point->state;
+    if (!load_parameters(abm_schema, params, saved.params, error)) return nullptr;
+    if (fork_step < 1 || fork_step > saved.params.total_steps) {
+        error = "the fork step must be between 1 and total_steps (" + to_string(saved.params.total_steps) + ")";
+        return nullptr;
+    }
+
+    ThreadPool pool(saved.params.num_threads);
+    AbmEngine engine(saved.params, pool);
+    engine.initialize();
+    for (int step = 0; step < fork_step; ++step) {
+        saved.history.push_back(engine.step());
+        if (!context.proceed(static_cast<double>(step + 1) / fork_step)) {
+            error = "the run was cancelled before the fork step";
+            return nullptr;
+        }
+    }
+    saved.steps_done = engine.steps_done();
+    saved.agents = engine.population();
+    return point;
+}
 
-    // Default probabilities, to be overwritten by file input
-    double infection_prob = 0.15;
-    double recovery_prob = 0.03;
-    double vaccination_prob = 0.02;
-    double quarantine_prob = 0.01;
+// Function to continue a forked run with changes over its parameters and write every row of the
+// branch; false if the changes are invalid or the run was cancelled
+bool branch(const ForkPoint& point, const ParameterSet& changes, ResultSink& out, const RunContext& context) {
+    const AbmCheckpoint& saved = static_cast<const AbmFork&>(point).state;
+    AbmParameters params = saved.params;
+    string error;
+    if (!check_branch_changes(abm_schema, changes, error) || !assign_parameters(abm_schema, changes, params, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    if (static_cast<uint64_t>(params.total_steps) < saved.steps_done) {
+        if (context.log) *context.log << "Error: total_steps ends the branch before the fork" << endl;
+        return false;
+    }
 
-    int infection_radius = 2;  // Agents can infect within 2 unit distance
-    int total_steps = 100;
+    ThreadPool pool(params.num_threads);
+    AbmEngine engine(params, pool);
+    engine.restore(saved.agents, saved.steps_done);
+    if (changes.count("vaccination_prob")) engine.vaccinate(params.vaccination_prob);
 
-    // Read parameters from file
-    read_parameters("ABM_params.txt", infection_prob, recovery_prob, vaccination_prob, quarantine_prob);
+    vector<StateCounts> history = saved.history;
+    return continue_simulation(engine, params, history, out, context, CheckpointSettings());
+}
+
+// Set by SIGINT, so an interrupted run saves a checkpoint before it exits
+atomic<bool> interrupted(false);
+
+void interrupt_handler(int) { interrupted = true; }
+
+// Function to load params over the defaults, run the ABM and write the population counts of
+// every step; false if the parameters are invalid or the run was cancelled
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context) {
+    AbmParameters p;
+    string error;
+    if (!load_parameters(abm_schema, params, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return abm_simulation(p, out, context);
+}
+
+}  // namespace abm
+
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char* argv[]) {
+    using namespace abm;
+
+    // --output-format columnar writes ABM_simulation_results.col instead of CSV;
+    // --checkpoint-every N saves the run to ABM_checkpoint.bin (or --checkpoint FILE) every N
+    // steps and on Ctrl-C; --resume FILE continues a run from its checkpoint, with the
+    // parameters it was started with and the thread count of ABM_params.txt
+    select_result_format(argc, argv);
+    CheckpointSettings checkpoint;
+    string resume_file;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--checkpoint" && i + 1 < argc) checkpoint.filename = argv[++i];
+        else if (arg == "--checkpoint-every" && i + 1 < argc) checkpoint.every = atoi(argv[++i]);
+        else if (arg == "--resume" && i + 1 < argc) resume_file = argv[++i];
+    }
+    if (checkpoint.every > 0 && checkpoint.filename.empty()) checkpoint.filename = "ABM_checkpoint.bin";
+
+    // Read parameters from file over the defaults
+    AbmParameters params;
+    string error;
+    if (!load_parameter_file(abm_schema, "ABM_params.txt", params, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    AbmCheckpoint saved;
+    if (!resume_file.empty() && !read_checkpoint(resume_file, saved, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
 
     // Run the simulation
-    abm_simulation(num_agents, grid_size, infection_prob, recovery_prob, vaccination_prob, quarantine_prob, infection_radius, total_steps);
+    unique_ptr<ResultSink> file = open_result_sink("ABM_simulation_results.csv");
+    RunContext context;
+    context.log = &cout;
+    if (!checkpoint.filename.empty()) {
+        context.cancel = &interrupted;
+        signal(SIGINT, interrupt_handler);
+    }
+    bool completed = resume_file.empty() ? abm_simulation(params, *file, context, checkpoint)
+                                         : resume_simulation(saved, params.num_threads, *file, context, checkpoint);
+    file->close();
 
+    if (!completed) {
+        cout << "Interrupted; resume with --resume " << checkpoint.filename << endl;
+        return 1;
+    }
     return 0;
 }
+#endif
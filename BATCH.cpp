@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <memory>
+#include "batch_runner.h"
+
+using namespace std;
+
+// Batch runner: every scenario of a sweep file, in one process.
+//
+//     g++ -std=c++17 -O2 -DEPIDEMIC_LIBRARY BATCH.cpp SEIR.cpp SIR.cpp SIS.cpp ABM.cpp BRANCHING.cpp MARKOV_PROCESS_SIR.cpp -pthread -o BATCH
+//     ./BATCH sweep.txt [--output FILE] [--threads N] [--cache DIR] [--cache-size MB] [--no-cache]
+//
+// See sweep_design.h for the sweep file and batch_runner.h for the result store, which is
+// written to <MODEL>_batch_results.col unless --output names another file. Scenarios found in
+// the result cache (.epidemic_cache, shared with the GUI, 1024 MB by default) are not rerun.
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " SWEEP_FILE [--output FILE] [--threads N] [--cache DIR] [--cache-size MB] [--no-cache]" << endl;
+        return 1;
+    }
+
+    string sweep_file = argv[1];
+    string output;
+    int num_threads = 0;  // 0 uses every hardware thread
+    string cache_directory = ".epidemic_cache";
+    double cache_megabytes = 1024;
+    bool use_cache = true;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) num_threads = atoi(argv[++i]);
+        else if (arg == "--cache" && i + 1 < argc) cache_directory = argv[++i];
+        else if (arg == "--cache-size" && i + 1 < argc) cache_megabytes = atof(argv[++i]);
+        else if (arg == "--no-cache") use_cache = false;
+    }
+
+    SweepSpec spec;
+    string error;
+    if (!read_sweep_spec(sweep_file, spec, error)) {
+        cerr << "Error: " << sweep_file << ": " << error << endl;
+        return 1;
+    }
+    if (output.empty()) output = spec.model + "_batch_results.col";
+
+    ThreadPool pool(num_threads);
+    cout << "Running " << spec.scenarios() << " " << spec.model << " scenarios on " << pool.size() << " threads" << endl;
+
+    unique_ptr<ResultCache> cache;
+    if (use_cache) cache.reset(new ResultCache(cache_directory, static_cast<uint64_t>(cache_megabytes * 1048576.0)));
+
+    BatchSummary summary;
+    if (!run_batch(spec, output, pool, &cout, cache.get(), summary, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    cout << "Batch complete: " << summary.completed << " of " << summary.scenarios << " scenarios ("
+         << summary.cached << " from the cache) in " << summary.seconds << " s. Results saved to " << output << endl;
+    return summary.completed == summary.scenarios ? 0 : 1;
+}
@@ -1,20 +1,36 @@
 #include <iostream>
 #include <vector>
 #include <random>
-#include <fstream>
-#include <unordered_map>
 #include <string>
+#include <algorithm>
+#include <mutex>
+#include <cstdlib>
+#include "random_streams.h"
+#include "thread_pool.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
+namespace branching {
+
+// Purposes that separate the random streams drawn by the simulation
+enum RandomPurpose { OffspringDraw, GenerationDraw };
+
+// Ceiling on infection counts: 2^53, the largest count result tables (which hold doubles) store
+// exactly. Generation sizes saturate here, and a single run stops once its cumulative count
+// would pass it. Poisson means are checked against it before drawing, so they cannot overflow.
+const long long infection_ceiling = 1LL << 53;
+
 // Function to generate the number of new infections for each individual using Poisson distribution
-int generate_new_infections(double reproduction_rate, mt19937& gen) {
+int generate_new_infections(double reproduction_rate, RandomStream& gen) {
     poisson_distribution<> poisson(reproduction_rate);
     return poisson(gen);
 }
 
 // Function to apply protective measures and adjust reproduction rate
-double apply_protective_measures(double reproduction_rate, double vaccination_prob, double quarantine_prob, double safe_practices_prob, mt19937& gen) {
+double apply_protective_measures(double reproduction_rate, double vaccination_prob, double quarantine_prob, double safe_practices_prob, RandomStream& gen) {
     uniform_real_distribution<> dist(0.0, 1.0);
     
     if (dist(gen) < vaccination_prob) {
@@ -30,85 +46,301 @@ double apply_protective_measures(double reproduction_rate, double vaccination_pr
     return reproduction_rate;
 }
 
-// Function to load parameters from a file
-unordered_map<string, double> load_parameters(const string& filename) {
-    unordered_map<string, double> params;
-    ifstream file(filename);
+// Function to draw the new infections of a whole generation at once. Each individual falls into
+// one of 8 classes depending on which protective measures apply to it; the class sizes are
+// multinomial and the offspring of n individuals with rate r is a single Poisson(n * r) draw,
+// which has the same distribution as summing the individual draws. The result saturates at
+// infection_ceiling.
+long long generate_generation_infections(long long infected, double reproduction_rate, double vaccination_prob,
+                                         double quarantine_prob, double safe_practices_prob, RandomStream& gen) {
+    double v = min(max(vaccination_prob, 0.0), 1.0);
+    double q = min(max(quarantine_prob, 0.0), 1.0);
+    double s = min(max(safe_practices_prob, 0.0), 1.0);
+
+    long long remaining = infected;
+    double remaining_prob = 1.0;
+    long long new_infections = 0;
 
-    if (file.is_open()) {
-        string key;
-        double value;
-        while (file >> key >> value) {
-            params[key] = value;
+    for (int measures = 0; measures < 8 && remaining > 0; ++measures) {
+        bool vaccinated = measures & 1, quarantined = measures & 2, safe_practices = measures & 4;
+        double class_prob = (vaccinated ? v : 1.0 - v) * (quarantined ? q : 1.0 - q) * (safe_practices ? s : 1.0 - s);
+        double class_rate = reproduction_rate * (vaccinated ? 0.1 : 1.0) * (quarantined ? 0.5 : 1.0) * (safe_practices ? 0.7 : 1.0);
+
+        // Multinomial class sizes as a chain of conditional binomials
+        long long class_size = remaining;
+        if (measures < 7 && class_prob < remaining_prob) {
+            binomial_distribution<long long> binomial(remaining, class_prob / remaining_prob);
+            class_size = binomial(gen);
+        }
+        remaining -= class_size;
+        remaining_prob -= class_prob;
+
+        if (class_size > 0 && class_rate > 0.0) {
+            double mean = class_size * class_rate;
+            if (mean >= static_cast<double>(infection_ceiling)) return infection_ceiling;
+            poisson_distribution<long long> poisson(mean);
+            new_infections += poisson(gen);
+            if (new_infections >= infection_ceiling) return infection_ceiling;
         }
-        file.close();
-    } else {
-        cerr << "Error: Could not open the file " << filename << endl;
     }
 
-    return params;
+    return new_infections;
 }
 
-// Function to simulate a branching process and write results to a CSV file
-void branching_process(double reproduction_rate, int initial_infected, int max_generations, const string& output_file, 
-                       double vaccination_prob, double quarantine_prob, double safe_practices_prob) {
-    vector<int> generations(max_generations, 0);
-    vector<int> cumulative_infections(max_generations, 0);
+// Function to simulate a branching process and write one row per generation.
+// With aggregate set, each generation is drawn in O(1) by generate_generation_infections;
+// otherwise every individual is sampled separately. The run stops early, after reporting it,
+// once the cumulative infections would pass infection_ceiling. Returns false if the run was
+// cancelled.
+bool branching_process(double reproduction_rate, int initial_infected, int max_generations, ResultSink& file, 
+                       double vaccination_prob, double quarantine_prob, double safe_practices_prob, uint64_t seed, bool aggregate,
+                       const RunContext& context) {
+    vector<long long> generations(max_generations, 0);
+    vector<long long> cumulative_infections(max_generations, 0);
 
     generations[0] = initial_infected;
     cumulative_infections[0] = initial_infected;
 
-    random_device rd;
-    mt19937 gen(rd());
-
-    ofstream file(output_file);
-    file << "Generation,New Infections,Cumulative Infections\n";
-    file << "0," << initial_infected << "," << initial_infected << "\n";
+    file.row("Generation", "New Infections", "Cumulative Infections");
+    file.row(0, initial_infected, initial_infected);
 
-    cout << "Generation 0: " << initial_infected << " infected individuals" << endl;
+    if (context.log) *context.log << "Generation 0: " << initial_infected << " infected individuals" << endl;
 
     for (int gen_idx = 1; gen_idx < max_generations; ++gen_idx) {
-        int new_infections = 0;
+        long long new_infections = 0;
+
+        if (aggregate) {
+            RandomStream gen(seed, 0, gen_idx, GenerationDraw);
+            new_infections = generate_generation_infections(generations[gen_idx - 1], reproduction_rate, vaccination_prob,
+                                                            quarantine_prob, safe_practices_prob, gen);
+        } else {
+            for (long long i = 0; i < generations[gen_idx - 1]; ++i) {
+                // Each individual draws from its own (seed, individual, generation) stream
+                RandomStream gen(seed, i, gen_idx, OffspringDraw);
+                double adjusted_reproduction_rate = apply_protective_measures(reproduction_rate, vaccination_prob, quarantine_prob, safe_practices_prob, gen);
+                new_infections += generate_new_infections(adjusted_reproduction_rate, gen);
+                if (new_infections >= infection_ceiling) break;
+            }
+        }
 
-        for (int i = 0; i < generations[gen_idx - 1]; ++i) {
-            double adjusted_reproduction_rate = apply_protective_measures(reproduction_rate, vaccination_prob, quarantine_prob, safe_practices_prob, gen);
-            new_infections += generate_new_infections(adjusted_reproduction_rate, gen);
+        if (new_infections > infection_ceiling - cumulative_infections[gen_idx - 1]) {
+            if (context.log) {
+                *context.log << "Stopped after " << gen_idx - 1 << " generations: generation " << gen_idx
+                             << " would take the cumulative infections past " << infection_ceiling << endl;
+            }
+            break;
         }
 
         generations[gen_idx] = new_infections;
         cumulative_infections[gen_idx] = cumulative_infections[gen_idx - 1] + new_infections;
 
-        file << gen_idx << "," << new_infections << "," << cumulative_infections[gen_idx] << "\n";
-        cout << "Generation " << gen_idx << ": " << new_infections << " infected individuals" << endl;
+        file.row(gen_idx, new_infections, cumulative_infections[gen_idx]);
+        if (context.log) *context.log << "Generation " << gen_idx << ": " << new_infections << " infected individuals" << endl;
 
         if (new_infections == 0) {
-            cout << "The epidemic has died out after " << gen_idx << " generations." << endl;
+            if (context.log) *context.log << "The epidemic has died out after " << gen_idx << " generations." << endl;
             break;
         }
+        if (!context.proceed(static_cast<double>(gen_idx + 1) / max_generations)) return false;
+    }
+    return true;
+}
+
+// Histogram of generation sizes: exact bins below 1024, then 32 log-spaced bins per power of two
+// (about 2% resolution). Counts are integers, so histograms merge identically in any order.
+class SizeHistogram {
+public:
+    SizeHistogram() : bins(BIN_COUNT, 0), total(0) {}
+
+    void add(long long size) {
+        bins[bin_of(size)]++;
+        total++;
+    }
+
+    void merge(const SizeHistogram& other) {
+        for (size_t b = 0; b < BIN_COUNT; ++b) bins[b] += other.bins[b];
+        total += other.total;
+    }
+
+    // Lower edge of the bin holding the p-quantile
+    long long quantile(double p) const {
+        long long target = static_cast<long long>(p * total);
+        long long seen = 0;
+        for (size_t b = 0; b < BIN_COUNT; ++b) {
+            seen += bins[b];
+            if (seen > target) return bin_lower(b);
+        }
+        return bin_lower(BIN_COUNT - 1);
+    }
+
+private:
+    static const long long EXACT = 1024;   // Sizes below this get their own bin
+    static const int EXACT_BITS = 10;
+    static const int SUB_BITS = 5;         // 32 bins per power of two above EXACT
+    static const size_t BIN_COUNT = EXACT + (63 - EXACT_BITS) * (1 << SUB_BITS);
+
+    vector<long long> bins;
+    long long total;
+
+    static size_t bin_of(long long v) {
+        if (v < EXACT) return static_cast<size_t>(max(v, 0LL));
+        int k = 0;
+        while ((v >> (k + 1)) != 0) ++k;
+        long long sub = (v >> (k - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+        return EXACT + (k - EXACT_BITS) * (1 << SUB_BITS) + sub;
     }
 
-    file.close();
+    static long long bin_lower(size_t b) {
+        if (b < static_cast<size_t>(EXACT)) return b;
+        size_t rest = b - EXACT;
+        int k = EXACT_BITS + static_cast<int>(rest >> SUB_BITS);
+        long long sub = rest & ((1 << SUB_BITS) - 1);
+        return (1LL << k) + (sub << (k - SUB_BITS));
+    }
+};
+
+// Function to run many independent branching-process replicas on a thread pool and write
+// aggregated statistics instead of per-replica results. Replica r draws generation g from the
+// (seed, r, g) stream, so replica 0 reproduces the aggregated single run with the same seed and
+// the statistics do not depend on the thread count.
+void branching_ensemble(double reproduction_rate, int initial_infected, int max_generations, const string& output_file,
+                        double vaccination_prob, double quarantine_prob, double safe_practices_prob, uint64_t seed,
+                        long long replicas, int num_threads) {
+    const long long batch_size = 1 << 16;  // Replicas between progress reports
+
+    ThreadPool pool(num_threads);
+    mutex merge_mutex;
+
+    vector<SizeHistogram> size_histograms(max_generations);
+    vector<long long> extinct_at(max_generations, 0);   // Replicas whose last infections were in the previous generation
+    vector<double> size_sums(max_generations, 0.0);
+
+    for (long long batch_start = 0; batch_start < replicas; batch_start += batch_size) {
+        long long batch_count = min(batch_size, replicas - batch_start);
+        size_t blocks = pool.default_blocks();
+        vector<vector<double> > block_sums(blocks, vector<double>(max_generations, 0.0));
+
+        pool.parallel_for(batch_count, blocks, [&](size_t begin, size_t end, size_t block) {
+            vector<SizeHistogram> local_histograms(max_generations);
+            vector<long long> local_extinct(max_generations, 0);
+            vector<double>& local_sums = block_sums[block];
+
+            for (size_t r = begin; r < end; ++r) {
+                uint64_t replica = batch_start + r;
+                long long infected = initial_infected;
+                local_histograms[0].add(infected);
+                local_sums[0] += infected;
+
+                for (int gen_idx = 1; gen_idx < max_generations; ++gen_idx) {
+                    if (infected > 0) {
+                        RandomStream gen(seed, replica, gen_idx, GenerationDraw);
+                        infected = generate_generation_infections(infected, reproduction_rate, vaccination_prob,
+                                                                  quarantine_prob, safe_practices_prob, gen);
+                        if (infected == 0) local_extinct[gen_idx]++;
+                    }
+                    local_histograms[gen_idx].add(infected);
+                    local_sums[gen_idx] += infected;
+                }
+            }
+
+            lock_guard<mutex> lock(merge_mutex);
+            for (int g = 0; g < max_generations; ++g) {
+                size_histograms[g].merge(local_histograms[g]);
+                extinct_at[g] += local_extinct[g];
+            }
+        });
+
+        // Floating-point sums are reduced in block order to stay reproducible
+        for (size_t b = 0; b < blocks; ++b) {
+            for (int g = 0; g < max_generations; ++g) size_sums[g] += block_sums[b][g];
+        }
+
+        long long done = batch_start + batch_count;
+        long long extinct = 0;
+        for (int g = 0; g < max_generations; ++g) extinct += extinct_at[g];
+        cout << "Replicas " << done << "/" << replicas << ": extinction probability "
+             << static_cast<double>(extinct) / done << endl;
+    }
+
+    unique_ptr<ResultSink> file = open_result_sink(output_file);
+    file->row("Generation", "Extinction Probability", "Extinct At Generation", "Mean New Infections", "P05", "P25", "Median", "P75", "P95");
+
+    long long extinct = 0;
+    double extinction_time_sum = 0.0;
+    for (int g = 0; g < max_generations; ++g) {
+        extinct += extinct_at[g];
+        extinction_time_sum += static_cast<double>(g) * extinct_at[g];
+        const SizeHistogram& h = size_histograms[g];
+        file->row(g, static_cast<double>(extinct) / replicas, static_cast<double>(extinct_at[g]) / replicas, size_sums[g] / replicas,
+                 h.quantile(0.05), h.quantile(0.25), h.quantile(0.5), h.quantile(0.75), h.quantile(0.95));
+    }
+    file->close();
+
+    cout << "Extinction probability within " << max_generations << " generations: "
+         << static_cast<double>(extinct) / replicas << endl;
+    if (extinct > 0) {
+        cout << "Mean time to extinction: " << extinction_time_sum / extinct << " generations" << endl;
+    }
+}
+
+// Function to load params over the defaults and run the aggregated branching process, writing
+// one row per generation; false if the parameters are invalid or the run was cancelled
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context) {
+    BranchingParameters p;
+    string error;
+    if (!load_parameters(branching_schema, params, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return branching_process(p.reproduction_rate, p.initial_infected, p.max_generations, out,
+                             p.vaccination_prob, p.quarantine_prob, p.safe_practices_prob, p.seed, true, context);
 }
 
-int main() {
-    double reproduction_rate = 2.0;
-    int initial_infected = 5;
-    int max_generations = 20;
+}  // namespace branching
+
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char* argv[]) {
+    using namespace branching;
     string output_file = "Branching_simulation_results.csv";
 
-    // Load parameters from the file
-    unordered_map<string, double> params = load_parameters("Branching_params.txt");
+    // Load parameters from the file over the defaults
+    BranchingParameters p;
+    string error;
+    if (!load_parameter_file(branching_schema, "Branching_params.txt", p, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
 
-    // Retrieve the parameters
-    double vaccination_prob = params["vaccination_prob"];
-    double quarantine_prob = params["quarantine_prob"];
-    double safe_practices_prob = params["safe_practices_prob"];
+    // Generations are sampled in aggregate unless --per-individual is given;
+    // --ensemble N runs N replicas on --threads T threads (default: all cores);
+    // --output-format columnar writes .col files instead of CSV
+    select_result_format(argc, argv);
+    bool aggregate = true;
+    long long replicas = 0;
+    int num_threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--per-individual") aggregate = false;
+        else if (arg == "--ensemble" && i + 1 < argc) replicas = atoll(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) num_threads = atoi(argv[++i]);
+    }
 
-    // Run the branching process simulation with loaded protective measures
-    branching_process(reproduction_rate, initial_infected, max_generations, output_file, 
-                      vaccination_prob, quarantine_prob, safe_practices_prob);
+    if (replicas > 0) {
+        output_file = "Branching_ensemble_results.csv";
+        branching_ensemble(p.reproduction_rate, p.initial_infected, p.max_generations, output_file,
+                           p.vaccination_prob, p.quarantine_prob, p.safe_practices_prob, p.seed, replicas, num_threads);
+    } else {
+        // Run the branching process simulation with loaded protective measures
+        unique_ptr<ResultSink> file = open_result_sink(output_file);
+        RunContext context;
+        context.log = &cout;
+        branching_process(p.reproduction_rate, p.initial_infected, p.max_generations, *file, 
+                          p.vaccination_prob, p.quarantine_prob, p.safe_practices_prob, p.seed, aggregate, context);
+        file->close();
+    }
 
-    cout << "Simulation results have been saved to " << output_file << endl;
+    cout << "Simulation results have been saved to " << result_filename(output_file) << endl;
 
     return 0;
 }
+#endif
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include "ode_integrators.h"
+#include "compartment_model.h"
+#include "result_sink.h"
+#include "params.h"
+
+using namespace std;
+
+// Function to load a catalogue model's parameters from COMPARTMENTAL_<NAME>_params.txt through
+// its schema. A missing file keeps the defaults. Returns false, with the reason in error, if the
+// file has an unknown name, a malformed line or an out-of-range value.
+bool read_parameters(const ParameterSchema& schema, CompartmentParameters& p, string& error) {
+    string filename = string(schema.model) + "_params.txt";
+    if (!ifstream(filename).is_open()) {
+        set_defaults(schema, p);
+        return true;
+    }
+    return load_parameter_file(schema, filename, p, error);
+}
+
+// Function to integrate a catalogue model and log every compartment to <NAME>_simulation_results.csv.
+// integrator and step override the parameter file when given (step > 0).
+template <typename Model>
+bool run_model(const ParameterSchema& schema, const string& integrator_name, double step) {
+    typedef typename Model::Kernel Kernel;
+    CompartmentParameters p;
+    string error;
+    if (!read_parameters(schema, p, error)) {
+        cerr << "Error: " << error << endl;
+        return false;
+    }
+    if (!integrator_name.empty()) p.integrator = parse_integrator(integrator_name, IntegratorKind(p.integrator));
+    if (step > 0) p.step = step;
+
+    typename Kernel::Rates rates;
+    typename Kernel::State y;
+    copy(p.rates, p.rates + rates.size(), rates.begin());
+    copy(p.initial, p.initial + y.size(), y.begin());
+    IntegratorOptions options = default_integrator_options(IntegratorKind(p.integrator), p.step > 0 ? p.step : p.dt);
+
+    string results_file = string(Model::name()) + "_simulation_results.csv";
+    unique_ptr<ResultSink> data_file = open_result_sink(results_file);
+    data_file->field("Time");
+    for (size_t c = 0; c < y.size(); ++c) data_file->field(Model::compartment_name(c));
+    data_file->end_row();
+    data_file->set_format(FixedFormat, 4);
+
+    int t = 0;
+    bool integrated = integrate(
+        [&](double, const typename Kernel::State& state, typename Kernel::State& dydt) {
+            Kernel::rhs(state, dydt, rates);
+        },
+        y, uniform_grid(0.0, p.dt, p.total_steps), vector<double>(), options,
+        [&](double current_time, const typename Kernel::State& state) {
+            data_file->field(current_time);
+            for (size_t c = 0; c < state.size(); ++c) data_file->field(state[c]);
+            data_file->end_row();
+
+            // Print to console for real-time monitoring
+            if (t % 100 == 0) {
+                cout << "Time: " << current_time;
+                for (size_t c = 0; c < state.size(); ++c) cout << " " << Model::compartment_name(c)[0] << ": " << state[c];
+                cout << endl;
+            }
+            ++t;
+        });
+    if (!integrated) {
+        cerr << "Error: " << integration_failure << endl;
+        return false;
+    }
+
+    cout << "Simulation complete. Data saved to " << result_filename(results_file) << endl;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // --model sir|seir|sis|seirs|seird|sirv picks the model (default seirs);
+    // --integrator and --step work as in the SIR and SEIR programs, over the parameter file;
+    // --output-format columnar writes <NAME>_simulation_results.col instead of CSV
+    select_result_format(argc, argv);
+    string model = "seirs";
+    string integrator;
+    double step = 0.0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc) model = argv[++i];
+        else if (arg == "--integrator" && i + 1 < argc) integrator = argv[++i];
+        else if (arg == "--step" && i + 1 < argc) step = atof(argv[++i]);
+    }
+
+    bool ok;
+    if (model == "sir") ok = run_model<SirModel>(sir_compartment_schema, integrator, step);
+    else if (model == "seir") ok = run_model<SeirModel>(seir_compartment_schema, integrator, step);
+    else if (model == "sis") ok = run_model<SisModel>(sis_compartment_schema, integrator, step);
+    else if (model == "seirs") ok = run_model<SeirsModel>(seirs_compartment_schema, integrator, step);
+    else if (model == "seird") ok = run_model<SeirdModel>(seird_compartment_schema, integrator, step);
+    else if (model == "sirv") ok = run_model<SirvModel>(sirv_compartment_schema, integrator, step);
+    else {
+        cerr << "Error: Unknown model " << model << endl;
+        return 1;
+    }
+
+    return ok ? 0 : 1;
+}
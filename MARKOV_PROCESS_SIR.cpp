@@ -1,25 +1,38 @@
 #include <iostream>
 #include <vector>
 #include <random>
-#include <fstream>
-#include <unordered_map>  // For storing parameters
+#include <cmath>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include "random_streams.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
+namespace markov {
+
 // Define the states for individuals in the population
 enum State { Susceptible, Infected, Recovered, Vaccinated };
 
-// Function to generate a random number between 0 and 1
-double get_random() {
-    static random_device rd;
-    static mt19937 generator(rd());
-    static uniform_real_distribution<double> dist(0.0, 1.0);
-    return dist(generator);
-}
+// Purposes that separate the random streams drawn by the simulation
+enum RandomPurpose { IndividualDraw, AggregateDraw, EventDraw, LeapDraw, CampaignDraw };
+
+// Simulation engines selectable with --engine
+enum Engine { IndividualEngine, BinomialEngine, DirectEngine, NextReactionEngine, TauLeapEngine };
+
+// Compartment counts of the population after a step
+struct Counts {
+    long long susceptible, infected, recovered, vaccinated;
+};
 
 // Function to simulate Markov Chain transitions for an individual
-State next_state(State current_state, double p_si, double p_ir, bool protective_measures) {
-    double r = get_random();
+State next_state(State current_state, double p_si, double p_ir, bool protective_measures, RandomStream& rng) {
+    double r = rng.uniform();
 
     if (protective_measures) {
         p_si *= 0.5;
@@ -34,83 +47,682 @@ State next_state(State current_state, double p_si, double p_ir, bool protective_
 }
 
 // Function to save the simulation results to a CSV file
-void save_to_csv(int step, int susceptible_count, int infected_count, int recovered_count, int vaccinated_count, ofstream& file) {
-    file << step << "," << susceptible_count << "," << infected_count << "," << recovered_count << "," << vaccinated_count << endl;
+void save_to_csv(int step, long long susceptible_count, long long infected_count, long long recovered_count, long long vaccinated_count, ResultSink& file) {
+    file.row(step, susceptible_count, infected_count, recovered_count, vaccinated_count);
+}
+
+// Initial counts: the vaccinated share of the population, one infected individual, the rest susceptible
+Counts initial_counts(long long population_size, double vaccination_rate) {
+    long long vaccinated = static_cast<long long>(population_size * vaccination_rate);
+    vaccinated = min(vaccinated, population_size - 1);
+    Counts counts = {population_size - vaccinated - 1, 1, 0, vaccinated};
+    return counts;
 }
 
-// Function to load parameters from a file
-unordered_map<string, double> load_parameters(const string& filename) {
-    unordered_map<string, double> params;
-    ifstream file(filename);
+// State of a per-step chain: the counts, and for the per-individual path every individual
+struct ChainState {
+    Counts counts;
+    vector<State> population;  // Per-individual path only
+};
 
-    if (file.is_open()) {
-        string key;
-        double value;
-        while (file >> key >> value) {
-            params[key] = value;
+ChainState initial_chain(long long population_size, double vaccination_rate, bool individuals) {
+    ChainState chain;
+    chain.counts = initial_counts(population_size, vaccination_rate);
+    if (individuals) {
+        chain.population.assign(population_size, Susceptible);
+        for (long long i = 0; i < chain.counts.vaccinated; ++i) {
+            chain.population[i] = Vaccinated;
         }
-        file.close();
+
+        chain.population[chain.counts.vaccinated] = Infected;
+    }
+    return chain;
+}
+
+// Per-individual path: walks every individual each step with its own random stream. Advances
+// the chain from first_step up to total_steps, adding the counts of each step to history.
+// Returns false if the run was cancelled.
+bool advance_individuals(ChainState& chain, double p_si, double p_ir, int first_step, int total_steps, double protective_measures_rate, uint64_t seed,
+                         vector<Counts>& history, const RunContext& context) {
+    vector<State>& population = chain.population;
+    long long population_size = static_cast<long long>(population.size());
+    for (int step = first_step; step < total_steps; ++step) {
+        Counts counts = {0, 0, 0, 0};
+
+        for (long long i = 0; i < population_size; ++i) {
+            if (population[i] != Vaccinated) {
+                // Each individual draws from its own (seed, individual, step) stream
+                RandomStream rng(seed, i, step, IndividualDraw);
+                bool uses_protection = rng.uniform() < protective_measures_rate;
+                population[i] = next_state(population[i], p_si, p_ir, uses_protection, rng);
+            }
+
+            if (population[i] == Susceptible) counts.susceptible++;
+            else if (population[i] == Infected) counts.infected++;
+            else if (population[i] == Recovered) counts.recovered++;
+            else if (population[i] == Vaccinated) counts.vaccinated++;
+        }
+
+        chain.counts = counts;
+        history.push_back(counts);
+        if (!context.proceed(static_cast<double>(step + 1) / total_steps)) return false;
+    }
+    return true;
+}
+
+bool simulate_individuals(int population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed,
+                          vector<Counts>& history, const RunContext& context) {
+    ChainState chain = initial_chain(population_size, vaccination_rate, true);
+    return advance_individuals(chain, p_si, p_ir, 0, total_steps, protective_measures_rate, seed, history, context);
+}
+
+// Aggregated binomial-chain path. Every susceptible shares the same infection probability
+// (averaged over protective measures) and every infected the same recovery probability, so the
+// S->I and I->R transitions of a step are binomial draws on the compartment counts. This has
+// the same distribution as the per-individual path at a cost independent of population size.
+// Returns false if the run was cancelled.
+bool advance_binomial_chain(ChainState& chain, double p_si, double p_ir, int first_step, int total_steps, double protective_measures_rate, uint64_t seed,
+                            vector<Counts>& history, const RunContext& context) {
+    double protection = min(max(protective_measures_rate, 0.0), 1.0);
+    double p_infection = min(max(p_si * (1.0 - 0.5 * protection), 0.0), 1.0);
+    double p_recovery = min(max(p_ir, 0.0), 1.0);
+
+    Counts& counts = chain.counts;
+    for (int step = first_step; step < total_steps; ++step) {
+        RandomStream rng(seed, 0, step, AggregateDraw);
+        binomial_distribution<long long> infections(counts.susceptible, p_infection);
+        binomial_distribution<long long> recoveries(counts.infected, p_recovery);
+        long long new_infected = infections(rng);
+        long long new_recovered = recoveries(rng);
+
+        counts.susceptible -= new_infected;
+        counts.infected += new_infected - new_recovered;
+        counts.recovered += new_recovered;
+
+        history.push_back(counts);
+        if (!context.proceed(static_cast<double>(step + 1) / total_steps)) return false;
+    }
+    return true;
+}
+
+bool simulate_binomial_chain(long long population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed,
+                             vector<Counts>& history, const RunContext& context) {
+    ChainState chain = initial_chain(population_size, vaccination_rate, false);
+    return advance_binomial_chain(chain, p_si, p_ir, 0, total_steps, protective_measures_rate, seed, history, context);
+}
+
+// Vaccinate each susceptible with the given probability, as a campaign at the given step
+void vaccinate(ChainState& chain, double vaccination_rate, int step, uint64_t seed) {
+    double p = min(max(vaccination_rate, 0.0), 1.0);
+    long long vaccinated = 0;
+    if (chain.population.empty()) {
+        RandomStream rng(seed, 0, step, CampaignDraw);
+        binomial_distribution<long long> campaign(chain.counts.susceptible, p);
+        vaccinated = campaign(rng);
     } else {
-        cerr << "Error: Could not open the file " << filename << endl;
+        for (size_t i = 0; i < chain.population.size(); ++i) {
+            if (chain.population[i] != Susceptible) continue;
+            RandomStream rng(seed, i, step, CampaignDraw);
+            if (rng.uniform() < p) {
+                chain.population[i] = Vaccinated;
+                vaccinated++;
+            }
+        }
     }
+    chain.counts.susceptible -= vaccinated;
+    chain.counts.vaccinated += vaccinated;
+}
+
+// A first-order reaction of the continuous-time model: individuals move from one compartment
+// to another at `rate` per individual, so the propensity is rate * count[from]
+struct Reaction {
+    State from;
+    State to;
+    double rate;
+};
 
-    return params;
+typedef array<long long, 4> Compartments;  // Indexed by State
+
+// Continuous-time reactions matching the per-step chain: a per-step probability p becomes the
+// hazard -ln(1 - p), so each transition has probability p of happening within one time unit
+// (unlike the per-step chain, an individual may be infected and recover within the same unit)
+vector<Reaction> sir_reactions(double p_si, double p_ir, double protective_measures_rate) {
+    double protection = min(max(protective_measures_rate, 0.0), 1.0);
+    double p_infection = min(max(p_si * (1.0 - 0.5 * protection), 0.0), 1.0 - 1e-12);
+    double p_recovery = min(max(p_ir, 0.0), 1.0 - 1e-12);
+
+    vector<Reaction> reactions;
+    Reaction infection = {Susceptible, Infected, -log(1.0 - p_infection)};
+    Reaction recovery = {Infected, Recovered, -log(1.0 - p_recovery)};
+    reactions.push_back(infection);
+    reactions.push_back(recovery);
+    return reactions;
 }
 
-// Simulation function for the Markov Chain SIR model with protective measures
-void markov_chain_sir(int population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate) {
-    vector<State> population(population_size, Susceptible);
+Compartments initial_compartments(long long population_size, double vaccination_rate) {
+    Counts counts = initial_counts(population_size, vaccination_rate);
+    Compartments c = {{counts.susceptible, counts.infected, counts.recovered, counts.vaccinated}};
+    return c;
+}
 
-    int vaccinated_count = population_size * vaccination_rate;
-    for (int i = 0; i < vaccinated_count; ++i) {
-        population[i] = Vaccinated;
+Counts to_counts(const Compartments& c) {
+    Counts counts = {c[Susceptible], c[Infected], c[Recovered], c[Vaccinated]};
+    return counts;
+}
+
+// Exponential waiting time with the given rate
+double exponential_draw(RandomStream& rng, double rate) {
+    return -log(1.0 - rng.uniform()) / rate;
+}
+
+// One event of the Gillespie direct method: draws the time of the next event and fires it.
+// If that time is past t_end (or nothing can fire) t is set to t_end and false is returned;
+// memorylessness lets the next event be redrawn from there.
+bool direct_method_event(const vector<Reaction>& reactions, Compartments& c, double& t, double t_end, RandomStream& rng, vector<double>& propensities) {
+    double total = 0.0;
+    for (size_t r = 0; r < reactions.size(); ++r) {
+        propensities[r] = reactions[r].rate * c[reactions[r].from];
+        total += propensities[r];
     }
+    if (total <= 0.0) {
+        t = t_end;
+        return false;
+    }
+
+    double next_time = t + exponential_draw(rng, total);
+    if (next_time > t_end) {
+        t = t_end;
+        return false;
+    }
+
+    double pick = rng.uniform() * total;
+    size_t fired = 0;
+    while (fired + 1 < reactions.size() && pick >= propensities[fired]) {
+        pick -= propensities[fired];
+        ++fired;
+    }
+    c[reactions[fired].from]--;
+    c[reactions[fired].to]++;
+    t = next_time;
+    return true;
+}
 
-    population[vaccinated_count] = Infected;
+// Events (or leaps) between checks for cancellation within one output step of the event-driven
+// engines, where a large population can spend a long time
+const unsigned long long cancel_check_events = 1 << 16;
 
-    ofstream file("MARKONIKOV_simulation_results.csv");
-    file << "Step,Susceptible,Infected,Recovered,Vaccinated" << endl;
+// Gillespie direct method. Events are simulated exactly and the state is only recorded at the
+// output times t = 1, 2, ..., total_steps (row `step` holds the state at t = step + 1, matching the
+// per-step engines), so idle stretches cost nothing. Returns false if the run was cancelled.
+bool simulate_ssa_direct(long long population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed,
+                         vector<Counts>& history, const RunContext& context) {
+    vector<Reaction> reactions = sir_reactions(p_si, p_ir, protective_measures_rate);
+    Compartments c = initial_compartments(population_size, vaccination_rate);
+    RandomStream rng(seed, 0, 0, EventDraw);
+
+    vector<double> propensities(reactions.size());
+    double t = 0.0;
+    unsigned long long events = 0;
 
     for (int step = 0; step < total_steps; ++step) {
-        int susceptible_count = 0, infected_count = 0, recovered_count = 0, current_vaccinated_count = 0;
+        double output_time = step + 1.0;
+        while (direct_method_event(reactions, c, t, output_time, rng, propensities)) {
+            if (++events % cancel_check_events == 0 && context.cancelled()) return false;
+        }
+        history.push_back(to_counts(c));
+        if (!context.proceed(static_cast<double>(step + 1) / total_steps)) return false;
+    }
 
-        for (int i = 0; i < population_size; ++i) {
-            if (population[i] != Vaccinated) {
-                bool uses_protection = get_random() < protective_measures_rate;
-                population[i] = next_state(population[i], p_si, p_ir, uses_protection);
+    return true;
+}
+
+// Adaptive tau-leaping with the Cao-Gillespie-Petzold (2006) step size. Reactions that could
+// exhaust their reactant within a few firings (fewer than critical_firings left) are treated as
+// critical and fire at most once per leap; the others fire Poisson(propensity * tau) times. The
+// leap is sized so no propensity is expected to change by more than a fraction epsilon. When the
+// chosen leap would be shorter than a few exact events, a batch of exact SSA events is run
+// instead, which keeps small populations exact. Returns false if the run was cancelled.
+bool simulate_tau_leaping(long long population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed,
+                          vector<Counts>& history, const RunContext& context) {
+    const double epsilon = 0.03;          // Bound on the relative propensity change per leap
+    const long long critical_firings = 10;
+    const double ssa_threshold = 10.0;    // Fall back to SSA when tau < ssa_threshold / a0
+    const int ssa_batch = 100;            // Exact events per fallback
+
+    vector<Reaction> reactions = sir_reactions(p_si, p_ir, protective_measures_rate);
+    Compartments c = initial_compartments(population_size, vaccination_rate);
+    RandomStream rng(seed, 0, 0, LeapDraw);
+
+    vector<double> propensities(reactions.size());
+    vector<bool> critical(reactions.size());
+    vector<long long> firings(reactions.size());
+    double t = 0.0;
+    unsigned long long leaps = 0;
+
+    for (int step = 0; step < total_steps; ++step) {
+        double output_time = step + 1.0;
+        while (t < output_time) {
+            if (++leaps % cancel_check_events == 0 && context.cancelled()) return false;
+            double total = 0.0, critical_total = 0.0;
+            for (size_t r = 0; r < reactions.size(); ++r) {
+                propensities[r] = reactions[r].rate * c[reactions[r].from];
+                critical[r] = propensities[r] > 0.0 && c[reactions[r].from] < critical_firings;
+                total += propensities[r];
+                if (critical[r]) critical_total += propensities[r];
+            }
+            if (total <= 0.0) {
+                t = output_time;
+                break;
+            }
+
+            // Expected drift and variance of each compartment from the non-critical reactions
+            array<double, 4> drift = {{0.0, 0.0, 0.0, 0.0}};
+            array<double, 4> variance = {{0.0, 0.0, 0.0, 0.0}};
+            for (size_t r = 0; r < reactions.size(); ++r) {
+                if (critical[r]) continue;
+                drift[reactions[r].from] -= propensities[r];
+                drift[reactions[r].to] += propensities[r];
+                variance[reactions[r].from] += propensities[r];
+                variance[reactions[r].to] += propensities[r];
+            }
+
+            // Every reaction is first order, so the highest-order factor g is 1 for every reactant
+            double tau_noncritical = numeric_limits<double>::infinity();
+            for (size_t r = 0; r < reactions.size(); ++r) {
+                if (critical[r] || propensities[r] <= 0.0) continue;
+                State x = reactions[r].from;
+                double bound = max(epsilon * c[x], 1.0);
+                if (drift[x] != 0.0) tau_noncritical = min(tau_noncritical, bound / fabs(drift[x]));
+                if (variance[x] > 0.0) tau_noncritical = min(tau_noncritical, bound * bound / variance[x]);
+            }
+
+            if (tau_noncritical < ssa_threshold / total) {
+                for (int k = 0; k < ssa_batch && direct_method_event(reactions, c, t, output_time, rng, propensities); ++k) {
+                }
+                continue;
+            }
+
+            for (;;) {
+                double tau_critical = critical_total > 0.0 ? exponential_draw(rng, critical_total) : numeric_limits<double>::infinity();
+                double tau = min(min(tau_noncritical, tau_critical), output_time - t);
+                bool fire_critical = tau_critical <= min(tau_noncritical, output_time - t);
+
+                Compartments next = c;
+                for (size_t r = 0; r < reactions.size(); ++r) {
+                    firings[r] = 0;
+                    if (!critical[r] && propensities[r] > 0.0) {
+                        poisson_distribution<long long> poisson(propensities[r] * tau);
+                        firings[r] = poisson(rng);
+                    }
+                }
+                if (fire_critical) {
+                    double pick = rng.uniform() * critical_total;
+                    size_t chosen = 0;
+                    for (size_t r = 0; r < reactions.size(); ++r) {
+                        if (!critical[r]) continue;
+                        chosen = r;
+                        if (pick < propensities[r]) break;
+                        pick -= propensities[r];
+                    }
+                    firings[chosen]++;
+                }
+                for (size_t r = 0; r < reactions.size(); ++r) {
+                    next[reactions[r].from] -= firings[r];
+                    next[reactions[r].to] += firings[r];
+                }
+
+                bool negative = false;
+                for (size_t k = 0; k < next.size(); ++k) negative = negative || next[k] < 0;
+                if (negative) {
+                    // Leap overshot: retry with half the non-critical step
+                    tau_noncritical /= 2.0;
+                    continue;
+                }
+
+                c = next;
+                t = (tau >= output_time - t) ? output_time : t + tau;
+                break;
+            }
+        }
+        history.push_back(to_counts(c));
+        if (!context.proceed(static_cast<double>(step + 1) / total_steps)) return false;
+    }
+
+    return true;
+}
+
+// Binary min-heap of reaction firing times that also tracks each reaction's heap position, so a
+// reaction's time can be changed in O(log reactions)
+class IndexedPriorityQueue {
+public:
+    explicit IndexedPriorityQueue(const vector<double>& times)
+        : times(times), heap(times.size()), position(times.size()) {
+        for (size_t i = 0; i < heap.size(); ++i) {
+            heap[i] = i;
+            position[i] = i;
+        }
+        for (size_t i = heap.size() / 2; i-- > 0;) sift_down(i);
+    }
+
+    size_t top() const { return heap[0]; }
+    double top_time() const { return times[heap[0]]; }
+    double time_of(size_t reaction) const { return times[reaction]; }
+
+    void update(size_t reaction, double time) {
+        times[reaction] = time;
+        sift_up(position[reaction]);
+        sift_down(position[reaction]);
+    }
+
+private:
+    vector<double> times;
+    vector<size_t> heap;       // Reactions ordered as a heap on their times
+    vector<size_t> position;   // Heap slot of each reaction
+
+    void swap_slots(size_t a, size_t b) {
+        swap(heap[a], heap[b]);
+        position[heap[a]] = a;
+        position[heap[b]] = b;
+    }
+
+    void sift_up(size_t i) {
+        while (i > 0 && times[heap[i]] < times[heap[(i - 1) / 2]]) {
+            swap_slots(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t i) {
+        for (;;) {
+            size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+            if (left < heap.size() && times[heap[left]] < times[heap[smallest]]) smallest = left;
+            if (right < heap.size() && times[heap[right]] < times[heap[smallest]]) smallest = right;
+            if (smallest == i) return;
+            swap_slots(i, smallest);
+            i = smallest;
+        }
+    }
+};
+
+// Gibson-Bruck next-reaction method. Each reaction keeps an absolute firing time in an indexed
+// priority queue; after an event only the reactions whose propensity changed are rescheduled,
+// reusing their remaining waiting time instead of drawing new random numbers. Returns false if
+// the run was cancelled.
+bool simulate_next_reaction(long long population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed,
+                            vector<Counts>& history, const RunContext& context) {
+    const double never = numeric_limits<double>::infinity();
+    vector<Reaction> reactions = sir_reactions(p_si, p_ir, protective_measures_rate);
+    Compartments c = initial_compartments(population_size, vaccination_rate);
+    RandomStream rng(seed, 0, 0, EventDraw);
+
+    // Reactions whose propensity depends on each compartment
+    vector<vector<size_t> > dependents(c.size());
+    for (size_t r = 0; r < reactions.size(); ++r) {
+        dependents[reactions[r].from].push_back(r);
+    }
+
+    vector<double> propensities(reactions.size());
+    vector<double> firing_times(reactions.size());
+    for (size_t r = 0; r < reactions.size(); ++r) {
+        propensities[r] = reactions[r].rate * c[reactions[r].from];
+        firing_times[r] = propensities[r] > 0.0 ? exponential_draw(rng, propensities[r]) : never;
+    }
+    IndexedPriorityQueue queue(firing_times);
+
+    double t = 0.0;
+    unsigned long long events = 0;
+
+    for (int step = 0; step < total_steps; ++step) {
+        double output_time = step + 1.0;
+        while (queue.top_time() <= output_time) {
+            if (++events % cancel_check_events == 0 && context.cancelled()) return false;
+            size_t fired = queue.top();
+            t = queue.top_time();
+            c[reactions[fired].from]--;
+            c[reactions[fired].to]++;
+
+            State touched[2] = {reactions[fired].from, reactions[fired].to};
+            for (int k = 0; k < 2; ++k) {
+                for (size_t d = 0; d < dependents[touched[k]].size(); ++d) {
+                    size_t r = dependents[touched[k]][d];
+                    double old_propensity = propensities[r];
+                    double new_propensity = reactions[r].rate * c[reactions[r].from];
+                    if (new_propensity == old_propensity && r != fired) continue;
+                    propensities[r] = new_propensity;
+
+                    double next_time;
+                    if (new_propensity <= 0.0) {
+                        next_time = never;
+                    } else if (r != fired && old_propensity > 0.0) {
+                        next_time = t + (old_propensity / new_propensity) * (queue.time_of(r) - t);
+                    } else {
+                        next_time = t + exponential_draw(rng, new_propensity);
+                    }
+                    queue.update(r, next_time);
+                }
             }
+        }
+        history.push_back(to_counts(c));
+        if (!context.proceed(static_cast<double>(step + 1) / total_steps)) return false;
+    }
+
+    return true;
+}
+
+// Function to write the counts of every step once the engine has made them; returns false if
+// the run was cancelled
+bool write_history(const vector<Counts>& history, ResultSink& file, const RunContext& context) {
+    int total_steps = static_cast<int>(history.size());
+    file.row("Step", "Susceptible", "Infected", "Recovered", "Vaccinated");
 
-            if (population[i] == Susceptible) susceptible_count++;
-            else if (population[i] == Infected) infected_count++;
-            else if (population[i] == Recovered) recovered_count++;
-            else if (population[i] == Vaccinated) current_vaccinated_count++;
+    for (int step = 0; step < total_steps; ++step) {
+        const Counts& counts = history[step];
+        save_to_csv(step, counts.susceptible, counts.infected, counts.recovered, counts.vaccinated, file);
+
+        if (context.log) {
+            *context.log << "Step " << step << ": Susceptible = " << counts.susceptible
+                 << ", Infected = " << counts.infected
+                 << ", Recovered = " << counts.recovered
+                 << ", Vaccinated = " << counts.vaccinated << endl;
         }
+        if (context.cancelled()) return false;
+    }
+    return true;
+}
 
-        save_to_csv(step, susceptible_count, infected_count, recovered_count, current_vaccinated_count, file);
+// Simulation function for the Markov Chain SIR model with protective measures; returns false if
+// the run was cancelled
+bool markov_chain_sir(int population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed, Engine engine,
+                      ResultSink& file, const RunContext& context) {
+    vector<Counts> history;
+    bool finished = false;
+    switch (engine) {
+        case IndividualEngine: finished = simulate_individuals(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, seed, history, context); break;
+        case BinomialEngine: finished = simulate_binomial_chain(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, seed, history, context); break;
+        case DirectEngine: finished = simulate_ssa_direct(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, seed, history, context); break;
+        case NextReactionEngine: finished = simulate_next_reaction(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, seed, history, context); break;
+        case TauLeapEngine: finished = simulate_tau_leaping(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, seed, history, context); break;
+    }
+    return finished && write_history(history, file, context);
+}
 
-        cout << "Step " << step << ": Susceptible = " << susceptible_count
-             << ", Infected = " << infected_count
-             << ", Recovered = " << recovered_count
-             << ", Vaccinated = " << current_vaccinated_count << endl;
+// Function to check the binomial chain against the per-individual path. Both are run for the
+// given number of replicas and, for every step, the difference of the mean susceptible and
+// infected counts is compared with its standard error. Returns true when no step differs by
+// more than the given number of standard errors.
+bool compare_engines(int population_size, double p_si, double p_ir, int total_steps, double vaccination_rate, double protective_measures_rate, uint64_t seed, int replicas, double max_z = 4.0) {
+    vector<double> sum[2][2], sum_sq[2][2];  // [engine][compartment]
+    for (int e = 0; e < 2; ++e) {
+        for (int c = 0; c < 2; ++c) {
+            sum[e][c].assign(total_steps, 0.0);
+            sum_sq[e][c].assign(total_steps, 0.0);
+        }
     }
 
-    file.close();
+    for (int r = 0; r < replicas; ++r) {
+        uint64_t replica_seed = mix64(seed + r);
+        vector<Counts> runs[2];
+        simulate_individuals(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, replica_seed, runs[0], RunContext());
+        simulate_binomial_chain(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate, replica_seed, runs[1], RunContext());
+        for (int e = 0; e < 2; ++e) {
+            for (int step = 0; step < total_steps; ++step) {
+                double values[2] = {static_cast<double>(runs[e][step].susceptible), static_cast<double>(runs[e][step].infected)};
+                for (int c = 0; c < 2; ++c) {
+                    sum[e][c][step] += values[c];
+                    sum_sq[e][c][step] += values[c] * values[c];
+                }
+            }
+        }
+    }
+
+    double worst_z = 0.0;
+    for (int c = 0; c < 2; ++c) {
+        for (int step = 0; step < total_steps; ++step) {
+            double mean[2], var[2];
+            for (int e = 0; e < 2; ++e) {
+                mean[e] = sum[e][c][step] / replicas;
+                var[e] = max(sum_sq[e][c][step] / replicas - mean[e] * mean[e], 0.0);
+            }
+            double std_error = sqrt((var[0] + var[1]) / replicas);
+            if (std_error > 0.0) {
+                worst_z = max(worst_z, fabs(mean[0] - mean[1]) / std_error);
+            }
+        }
+    }
+
+    cout << "Largest difference between per-individual and binomial-chain means: " << worst_z
+         << " standard errors over " << replicas << " replicas" << endl;
+    return worst_z <= max_z;
+}
+
+// Function to run the chain with the engine p picks and write the counts of every step
+bool run(const MarkovParameters& p, ResultSink& out, const RunContext& context) {
+    return markov_chain_sir(p.population_size, p.p_si, p.p_ir, p.total_steps, p.vaccination_rate, p.protective_measures_rate, p.seed,
+                            static_cast<Engine>(p.engine), out, context);
+}
+
+// Function to load params over the defaults and run the chain; false if the parameters are
+// invalid or the run was cancelled
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context) {
+    MarkovParameters p;
+    string error;
+    if (!load_parameters(markov_schema, params, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return run(p, out, context);
+}
+
+// A chain stopped after its fork step; branches continue copies of its state
+struct MarkovFork : ForkPoint {
+    MarkovParameters params;
+    ChainState chain;
+    vector<Counts> history;  // Counts after each step up to the fork
+};
+
+// Advance a per-step chain from first_step to total_steps with the engine of p; false if the
+// run was cancelled
+bool advance_chain(ChainState& chain, const MarkovParameters& p, int first_step, vector<Counts>& history, const RunContext& context) {
+    if (p.engine == IndividualEngine) {
+        return advance_individuals(chain, p.p_si, p.p_ir, first_step, p.total_steps, p.protective_measures_rate, p.seed, history, context);
+    }
+    return advance_binomial_chain(chain, p.p_si, p.p_ir, first_step, p.total_steps, p.protective_measures_rate, p.seed, history, context);
 }
 
-int main() {
-    int population_size = 100;
-    double p_si = 0.05;
-    double p_ir = 0.01;
-    int total_steps = 100;
+// Function to run the chain to the end of step fork_step and keep its state for branches; null,
+// with the reason in error, if the parameters are invalid or the run was cancelled. Only the
+// per-step engines (individual and binomial) can fork.
+shared_ptr<const ForkPoint> fork(const ParameterSet& params, int fork_step, const RunContext& context, string& error) {
+    shared_ptr<MarkovFork> point = make_shared<MarkovFork>();
+    if (!load_parameters(markov_schema, params, point->params, error)) return nullptr;
+    MarkovParameters p = point->params;
+    if (p.engine != IndividualEngine && p.engine != BinomialEngine) {
+        error = "only the individual and binomial engines can fork";
+        return nullptr;
+    }
+    if (fork_step < 1 || fork_step > p.total_steps) {
+        error = "the fork step must be between 1 and total_steps (" + to_string(p.total_steps) + ")";
+        return nullptr;
+    }
+
+    point->chain = initial_chain(p.population_size, p.vaccination_rate, p.engine == IndividualEngine);
+    p.total_steps = fork_step;
+    if (!advance_chain(point->chain, p, 0, point->history, context)) {
+        error = "the run was cancelled before the fork step";
+        return nullptr;
+    }
+    return point;
+}
+
+// Function to continue a forked chain with changes over its parameters and write every row of
+// the branch; false if the changes are invalid or the run was cancelled
+bool branch(const ForkPoint& point, const ParameterSet& changes, ResultSink& out, const RunContext& context) {
+    const MarkovFork& saved = static_cast<const MarkovFork&>(point);
+    MarkovParameters p = saved.params;
+    string error;
+    if (!check_branch_changes(markov_schema, changes, error) || !assign_parameters(markov_schema, changes, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    int fork_step = static_cast<int>(saved.history.size());
+    if (p.total_steps < fork_step) {
+        if (context.log) *context.log << "Error: total_steps ends the branch before the fork" << endl;
+        return false;
+    }
+
+    ChainState chain = saved.chain;
+    if (changes.count("vaccination_rate")) vaccinate(chain, p.vaccination_rate, fork_step, p.seed);
 
-    // Load parameters from the file
-    unordered_map<string, double> params = load_parameters("MARKONIKOV_params.txt");
+    vector<Counts> history = saved.history;
+    return advance_chain(chain, p, fork_step, history, context) && write_history(history, out, context);
+}
+
+}  // namespace markov
+
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char* argv[]) {
+    using namespace markov;
+
+    // Load parameters from the file over the defaults
+    MarkovParameters p;
+    string error;
+    if (!load_parameter_file(markov_schema, "MARKONIKOV_params.txt", p, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
 
-    // Retrieve the parameters
-    double vaccination_rate = params["vaccination_rate"];
-    double protective_measures_rate = params["protective_measures_rate"];
+    // --engine individual|binomial|ssa|next-reaction|tau-leap selects the simulation engine;
+    // --compare-engines N checks the binomial chain against the per-individual path over N replicas;
+    // --output-format columnar writes MARKONIKOV_simulation_results.col instead of CSV
+    select_result_format(argc, argv);
+    int compare_replicas = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--engine" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "individual") p.engine = IndividualEngine;
+            else if (name == "binomial") p.engine = BinomialEngine;
+            else if (name == "ssa") p.engine = DirectEngine;
+            else if (name == "next-reaction") p.engine = NextReactionEngine;
+            else if (name == "tau-leap") p.engine = TauLeapEngine;
+            else {
+                cerr << "Error: Unknown engine " << name << "; use individual, binomial, ssa, next-reaction or tau-leap" << endl;
+                return 1;
+            }
+        } else if (arg == "--compare-engines" && i + 1 < argc) compare_replicas = atoi(argv[++i]);
+    }
+
+    if (compare_replicas > 0) {
+        bool consistent = compare_engines(p.population_size, p.p_si, p.p_ir, p.total_steps, p.vaccination_rate, p.protective_measures_rate, p.seed, compare_replicas);
+        return consistent ? 0 : 1;
+    }
 
-    markov_chain_sir(population_size, p_si, p_ir, total_steps, vaccination_rate, protective_measures_rate);
+    unique_ptr<ResultSink> file = open_result_sink("MARKONIKOV_simulation_results.csv");
+    RunContext context;
+    context.log = &cout;
+    run(p, *file, context);
+    file->close();
 
     return 0;
 }
+#endif
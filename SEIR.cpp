@@ -2,106 +2,301 @@
 #include <fstream>
 #include <cmath>
 #include <iomanip>  // For better number formatting
-#include <sstream>  // For parsing the file
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <array>
+#include <vector>
+#include "ode_integrators.h"
+#include "compartment_model.h"
+#include "ode_ensemble.h"
+#include "age_structured.h"
+#include "metapopulation.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
-// Function to update values of S, E, I, R using Euler's method for SEIR model
-void seir_model(double& S, double& E, double& I, double& R, double beta, double sigma, double gamma, double vaccination_rate, double dt) {
-    double dS = -beta * S * I - vaccination_rate * S;
-    double dE = beta * S * I - sigma * E;
-    double dI = sigma * E - gamma * I;
-    double dR = gamma * I + vaccination_rate * S;
-
-    S += dS * dt;
-    E += dE * dt;
-    I += dI * dt;
-    R += dR * dt;
+namespace seir {
+
+// Function to compute the rates of change of S, E, I, R for the SEIR model
+void seir_model(const array<double, 4>& y, array<double, 4>& dydt, double beta, double sigma, double gamma, double vaccination_rate) {
+    SeirModel::Kernel::Rates rates = {{beta, sigma, gamma, vaccination_rate}};
+    SeirModel::Kernel::rhs(y, dydt, rates);
 }
 
 // Function to log data to a file
-void log_data(ofstream& file, double time, double S, double E, double I, double R) {
-    file << fixed << setprecision(4) << time << "," << S << "," << E << "," << I << "," << R << endl;
+void log_data(ResultSink& file, double time, double S, double E, double I, double R) {
+    file.row(time, S, E, I, R);
+}
+
+// Function to get the rates of one ensemble lane from the run parameters
+LaneParameters lane_parameters(const SeirParameters& p) {
+    LaneParameters lane = {p.beta, p.reduced_beta, p.sigma, p.gamma, p.quarantine_time, p.vaccination_rate, p.vaccination_start, p.vaccination_speed};
+    return lane;
 }
 
-// Function to read parameters from a file
-void read_parameters(const string& filename, double& quarantine_time, double& reduced_beta, double& vaccination_rate, double& vaccination_start, double& vaccination_speed) {
-    ifstream file(filename);
-    string line;
-    
-    while (getline(file, line)) {
-        stringstream ss(line);
-        string param;
-        double value;
-        
-        getline(ss, param, '=');
-        ss >> value;
-        
-        if (param == "quarantine_time") quarantine_time = value;
-        if (param == "reduced_beta") reduced_beta = value;
-        if (param == "vaccination_rate") vaccination_rate = value;
-        if (param == "vaccination_start") vaccination_start = value;
-        if (param == "vaccination_speed") vaccination_speed = value;
+// Function to get the initial compartments from the run parameters
+EnsembleInitialState initial_state(const SeirParameters& p) {
+    EnsembleInitialState y0 = {p.initial_susceptible, p.initial_exposed, p.initial_infectious, p.initial_recovered};
+    return y0;
+}
+
+// Function to integrate every parameter set of a sweep file at once and save one summary row per set
+bool run_sweep(const string& sweep_file, const LaneParameters& base, const EnsembleInitialState& initial, double step, double duration, int num_threads) {
+    EnsembleParameters sweep;
+    string error;
+    if (!read_parameter_sweep(sweep_file, base, sweep, error)) {
+        cerr << "Error: " << error << endl;
+        return false;
     }
+
+    ThreadPool pool(num_threads);
+    EnsembleSummary summary;
+    integrate_ensemble(sweep, initial, true, step, static_cast<int>(duration / step + 0.5), pool, summary);
+    write_ensemble_summary("SEIR_sweep_results.csv", sweep, summary);
+    cout << "Integrated " << sweep.size() << " parameter sets. Summary saved to " << result_filename("SEIR_sweep_results.csv") << endl;
+    return true;
 }
 
-int main() {
-    // Adjusted Initial Conditions for the SEIR model
-    double S = 0.94;  // Initial Susceptible
-    double E = 0.01;  // Initial Exposed
-    double I = 0.05;  // Initial Infectious
-    double R = 0.0;   // Initial Recovered
-
-    // Parameters (initial values, will be overwritten by file input)
-    double beta = 0.6;    // Transmission rate
-    double sigma = 0.1;   // Rate at which exposed individuals become infectious
-    double gamma = 0.2;   // Recovery rate
-    double dt = 0.01;     // Time step
-    int total_steps = 20000;  // Simulate for 200 days (20,000 * 0.01 = 200)
-
-    // Protective Measures
-    double quarantine_time = 20;     // Quarantine starts after 20 days
-    double reduced_beta = 0.35;      // Adjusted reduced transmission rate during quarantine
-    double vaccination_rate = 0.0;   // No vaccination initially
-    double vaccination_start = 30;   // Vaccination starts at day 30
-    double vaccination_speed = 0.002; // Moderate vaccination rollout speed
-
-    // Read the parameters from the file
-    read_parameters("parameters.txt", quarantine_time, reduced_beta, vaccination_rate, vaccination_start, vaccination_speed);
+// Function to run the age-structured model and log totals plus each band's infectious share
+bool run_age_structured(AgeStructuredSeir& model, const string& contacts_file, const string& bands_file,
+                        double S, double E, double I, double R, double dt, int total_steps, const IntegratorOptions& options) {
+    if (!read_contact_matrix(contacts_file, model.contacts)) {
+        cerr << "Error: Could not read a square matrix of non-negative numbers from " << contacts_file << endl;
+        return false;
+    }
+    size_t bands = model.bands();
+    if (bands_file.empty()) {
+        model.population.assign(bands, 1.0 / bands);
+        model.priority.assign(bands, 1.0);
+    } else if (!read_age_bands(bands_file, model.population, model.priority) || model.population.size() != bands) {
+        cerr << "Error: " << bands_file << " must list a non-negative population and vaccination_priority for all " << bands << " bands" << endl;
+        return false;
+    }
 
-    // Open a file to log the results
-    ofstream data_file("SEIR_simulation_results.csv");
-    data_file << "Time,Susceptible,Exposed,Infectious,Recovered\n";
+    unique_ptr<ResultSink> data_file = open_result_sink("SEIR_age_results.csv");
+    for (const char* name : {"Time", "Susceptible", "Exposed", "Infectious", "Recovered"}) data_file->field(name);
+    for (size_t a = 0; a < bands; ++a) data_file->field("Infectious Band " + to_string(a));
+    data_file->end_row();
 
-    // Simulation loop to iterate over time
-    for (int t = 0; t <= total_steps; ++t) {
-        double current_time = t * dt;
+    vector<double> y = model.initial_state(S, E, I, R);
+    vector<double> breakpoints;
+    breakpoints.push_back(model.quarantine_time);
+    breakpoints.push_back(model.vaccination_start);
 
-        // Implement quarantine (reduce transmission rate after certain time)
-        if (current_time >= quarantine_time) {
-            beta = reduced_beta;
-        }
+    int t = 0;
+    bool integrated = integrate(
+        [&](double time, const vector<double>& state, vector<double>& dydt) {
+            model.rhs(time, state, dydt);
+        },
+        y, uniform_grid(0.0, dt, total_steps), breakpoints, options,
+        [&](double current_time, const vector<double>& state) {
+            double totals[4] = {0.0, 0.0, 0.0, 0.0};
+            for (size_t c = 0; c < 4; ++c) {
+                for (size_t a = 0; a < bands; ++a) totals[c] += state[c * bands + a];
+            }
+            data_file->set_format(FixedFormat, 4);
+            for (double value : {current_time, totals[0], totals[1], totals[2], totals[3]}) data_file->field(value);
+            data_file->set_format(FixedFormat, 6);
+            for (size_t a = 0; a < bands; ++a) data_file->field(state[model.offset(AgeStructuredSeir::I) + a]);
+            data_file->end_row();
 
-        // Implement vaccination after a certain time
-        if (current_time >= vaccination_start) {
-            vaccination_rate = vaccination_speed;
-        }
+            if (t % 100 == 0) {
+                cout << "Time: " << current_time << " S: " << totals[0] << " E: " << totals[1] << " I: " << totals[2] << " R: " << totals[3] << endl;
+            }
+            ++t;
+        });
+    if (!integrated) {
+        cerr << "Error: " << integration_failure << endl;
+        return false;
+    }
 
-        // Log data to the file
-        log_data(data_file, current_time, S, E, I, R);
+    cout << "Simulation complete. " << bands << " age bands saved to " << result_filename("SEIR_age_results.csv") << endl;
+    return true;
+}
+
+// Function to run the metapopulation model: daily totals to SEIR_metapopulation_results.csv
+// and one summary row per region to SEIR_metapopulation_regions.csv
+bool run_metapopulation(const string& regions_file, const string& mobility_file, const MetapopulationParameters& params,
+                        int days, int num_threads) {
+    vector<double> population, infected;
+    if (!read_regions(regions_file, population, infected)) {
+        cerr << "Error: Could not read regions with positive populations from " << regions_file << endl;
+        return false;
+    }
+    MobilityMatrix mobility;
+    if (!read_mobility(mobility_file, population.size(), mobility)) {
+        cerr << "Error: Could not read mobility edges for " << population.size() << " regions from " << mobility_file
+             << " (each region's fractions must add up to at most 1)" << endl;
+        return false;
+    }
 
-        // Update the values using the SEIR model
-        seir_model(S, E, I, R, beta, sigma, gamma, vaccination_rate, dt);
+    ThreadPool pool(num_threads);
+    MetapopulationSeir model(mobility, population, params, pool);
+    model.initialize(infected);
 
-        // Print to console for real-time monitoring
-        if (t % 100 == 0) {
-            cout << "Time: " << current_time << " S: " << S << " E: " << E << " I: " << I << " R: " << R << endl;
+    unique_ptr<ResultSink> data_file = open_result_sink("SEIR_metapopulation_results.csv");
+    data_file->row("Time", "Susceptible", "Exposed", "Infectious", "Recovered");
+    data_file->set_format(FixedFormat, 6);
+    MetapopulationTotals totals = {0.0, 0.0, 0.0, 0.0};
+    for (int day = 0; day <= days; ++day) {
+        if (day > 0) totals = model.advance_day();
+        else {
+            double total = 0.0;
+            for (size_t i = 0; i < population.size(); ++i) total += population[i];
+            for (size_t i = 0; i < population.size(); ++i) totals.infectious += min(infected[i], population[i]) / total;
+            totals.susceptible = 1.0 - totals.infectious;
+        }
+        data_file->row(day, totals.susceptible, totals.exposed, totals.infectious, totals.recovered);
+        if (day % 10 == 0) {
+            cout << "Day: " << day << " S: " << totals.susceptible << " E: " << totals.exposed << " I: " << totals.infectious << " R: " << totals.recovered << endl;
         }
     }
 
+    unique_ptr<ResultSink> regions_out = open_result_sink("SEIR_metapopulation_regions.csv");
+    regions_out->row("Region", "Peak Infectious", "Peak Day", "Attack Rate");
+    for (size_t i = 0; i < model.nodes(); ++i) {
+        regions_out->row(i, model.peak(i), model.peak_at(i), model.attack_rate(i));
+    }
+
+    cout << "Simulation complete. " << model.nodes() << " regions and " << mobility.edges()
+         << " mobility edges saved to " << result_filename("SEIR_metapopulation_results.csv") << endl;
+    return true;
+}
+
+// Function to integrate the SEIR model and write one row per logged time
+bool run(const SeirParameters& p, ResultSink& out, const RunContext& context) {
+    IntegratorKind integrator = static_cast<IntegratorKind>(p.integrator);
+    double step = p.step > 0.0 ? p.step : p.dt;
+
+    out.row("Time", "Susceptible", "Exposed", "Infectious", "Recovered");
+    out.set_format(FixedFormat, 4);
+
+    // Quarantine and the vaccination rollout switch on at fixed times; both are breakpoints
+    // the integrator must not step across
+    array<double, 4> y = {{p.initial_susceptible, p.initial_exposed, p.initial_infectious, p.initial_recovered}};
+    vector<double> breakpoints;
+    breakpoints.push_back(p.quarantine_time);
+    breakpoints.push_back(p.vaccination_start);
+
+    int t = 0;
+    bool integrated = integrate(
+        [&](double time, const array<double, 4>& state, array<double, 4>& dydt) {
+            double current_beta = (time >= p.quarantine_time) ? p.reduced_beta : p.beta;
+            double current_vaccination = (time >= p.vaccination_start) ? p.vaccination_speed : p.vaccination_rate;
+            seir_model(state, dydt, current_beta, p.sigma, p.gamma, current_vaccination);
+        },
+        y, uniform_grid(0.0, p.dt, p.total_steps), breakpoints, default_integrator_options(integrator, step),
+        [&](double current_time, const array<double, 4>& state) {
+            // Log data to the results
+            log_data(out, current_time, state[0], state[1], state[2], state[3]);
+
+            // Print to console for real-time monitoring
+            if (context.log && t % 100 == 0) {
+                *context.log << "Time: " << current_time << " S: " << state[0] << " E: " << state[1] << " I: " << state[2] << " R: " << state[3] << endl;
+            }
+            ++t;
+            return context.proceed(static_cast<double>(t) / (p.total_steps + 1));
+        });
+    if (!integrated) {
+        if (context.log) *context.log << "Error: " << integration_failure << endl;
+        return false;
+    }
+    return !context.cancelled();
+}
+
+// Function to load params over the defaults and run the SEIR model; false if they are invalid
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context) {
+    SeirParameters p;
+    string error;
+    if (!load_parameters(seir_schema, params, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return run(p, out, context);
+}
+
+}  // namespace seir
+
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char* argv[]) {
+    using namespace seir;
+
+    // Rates, protective measures, initial state and time grid, read from the file over the defaults
+    SeirParameters p;
+    string error;
+    if (!load_parameter_file(seir_schema, "SEIR_params.txt", p, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    // --integrator euler|rk4|dopri5 picks the method (default dopri5); --step sets the
+    // fixed (or initial adaptive) step, which defaults to the logging interval.
+    // --sweep FILE integrates every parameter set in FILE as one ensemble on --threads N threads.
+    // --contacts FILE runs the age-structured model with that contact matrix; --age-bands FILE
+    // gives each band's population and vaccination priority (default: equal shares and priority).
+    // --regions FILE with --mobility FILE runs the metapopulation model on --threads N threads.
+    // --output-format columnar writes .col files instead of CSV
+    select_result_format(argc, argv);
+    string sweep_file, contacts_file, bands_file, regions_file, mobility_file;
+    int num_threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--integrator" && i + 1 < argc) p.integrator = parse_integrator(argv[++i], static_cast<IntegratorKind>(p.integrator));
+        else if (arg == "--step" && i + 1 < argc) p.step = atof(argv[++i]);
+        else if (arg == "--sweep" && i + 1 < argc) sweep_file = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) num_threads = atoi(argv[++i]);
+        else if (arg == "--contacts" && i + 1 < argc) contacts_file = argv[++i];
+        else if (arg == "--age-bands" && i + 1 < argc) bands_file = argv[++i];
+        else if (arg == "--regions" && i + 1 < argc) regions_file = argv[++i];
+        else if (arg == "--mobility" && i + 1 < argc) mobility_file = argv[++i];
+    }
+
+    IntegratorKind integrator = static_cast<IntegratorKind>(p.integrator);
+    bool step_given = p.step > 0.0;
+    double duration = p.total_steps * p.dt;
+
+    if (!regions_file.empty() && !mobility_file.empty()) {
+        // Daily coupling with RK4 substeps of --step days (default 0.25)
+        double day_step = step_given ? p.step : 0.25;
+        MetapopulationParameters meta = {p.beta, p.reduced_beta, p.sigma, p.gamma, p.quarantine_time, p.vaccination_rate, p.vaccination_start,
+                                         p.vaccination_speed, max(1, static_cast<int>(1.0 / day_step + 0.5))};
+        return run_metapopulation(regions_file, mobility_file, meta, static_cast<int>(duration + 0.5), num_threads) ? 0 : 1;
+    }
+
+    if (!sweep_file.empty()) {
+        return run_sweep(sweep_file, lane_parameters(p), initial_state(p), step_given ? p.step : 0.1, duration, num_threads) ? 0 : 1;
+    }
+
+    if (!contacts_file.empty()) {
+        // Age bands are logged every 0.1 days to keep the per-band output manageable
+        AgeStructuredSeir model;
+        model.beta = p.beta;
+        model.reduced_beta = p.reduced_beta;
+        model.sigma = p.sigma;
+        model.gamma = p.gamma;
+        model.quarantine_time = p.quarantine_time;
+        model.vaccination_rate = p.vaccination_rate;
+        model.vaccination_start = p.vaccination_start;
+        model.vaccination_speed = p.vaccination_speed;
+        double age_dt = 0.1;
+        return run_age_structured(model, contacts_file, bands_file, p.initial_susceptible, p.initial_exposed, p.initial_infectious, p.initial_recovered,
+                                  age_dt, static_cast<int>(duration / age_dt + 0.5), default_integrator_options(integrator, step_given ? p.step : age_dt)) ? 0 : 1;
+    }
+
+    // Open a file to log the results
+    unique_ptr<ResultSink> data_file = open_result_sink("SEIR_simulation_results.csv");
+    RunContext context;
+    context.log = &cout;
+    bool completed = run(p, *data_file, context);
+
     // Close the file
-    data_file.close();
-    cout << "Simulation complete. Data saved to seir_simulation_results.csv" << endl;
+    data_file->close();
+    if (!completed) return 1;
+    cout << "Simulation complete. Data saved to " << result_filename("SEIR_simulation_results.csv") << endl;
 
     return 0;
 }
+#endif
@@ -2,108 +2,175 @@
 #include <fstream>
 #include <cmath>
 #include <iomanip>
-#include <unordered_map>
+#include <cstdlib>
 #include <string>
+#include <array>
+#include <vector>
+#include "ode_integrators.h"
+#include "compartment_model.h"
+#include "ode_ensemble.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
-// Function to update values of S, I, R using Euler's method
-void sir_model(double &S, double &I, double &R, double beta, double gamma, double vaccination_rate, double dt)
+namespace sir
 {
-    double dS = -beta * S * I - vaccination_rate * S;
-    double dI = beta * S * I - gamma * I;
-    double dR = gamma * I + vaccination_rate * S;
 
-    S += dS * dt;
-    I += dI * dt;
-    R += dR * dt;
+// Function to compute the rates of change of S, I, R
+void sir_model(const array<double, 3> &y, array<double, 3> &dydt, double beta, double gamma, double vaccination_rate)
+{
+    SirModel::Kernel::Rates rates = {{beta, gamma, vaccination_rate}};
+    SirModel::Kernel::rhs(y, dydt, rates);
 }
 
 // Function to log data to a file
-void log_data(ofstream &file, double time, double S, double I, double R)
+void log_data(ResultSink &file, double time, double S, double I, double R)
 {
-    file << fixed << setprecision(4) << time << "," << S << "," << I << "," << R << endl;
+    file.row(time, S, I, R);
 }
 
-// Function to load parameters from a file
-unordered_map<string, double> load_parameters(const string& filename)
+// Function to get the rates of one ensemble lane from the run parameters (no exposed compartment)
+LaneParameters lane_parameters(const SirParameters &p)
 {
-    unordered_map<string, double> params;
-    ifstream file(filename);
-
-    if (file.is_open()) {
-        string key;
-        double value;
-        while (file >> key >> value) {
-            params[key] = value;
-        }
-        file.close();
-    } else {
-        cerr << "Error: Could not open the file " << filename << endl;
-    }
+    LaneParameters lane = {p.beta, p.reduced_beta, 0.0, p.gamma, p.quarantine_time, p.vaccination_rate, p.vaccination_start, p.vaccination_speed};
+    return lane;
+}
 
-    return params;
+// Function to get the initial compartments from the run parameters
+EnsembleInitialState initial_state(const SirParameters &p)
+{
+    EnsembleInitialState y0 = {p.initial_susceptible, 0.0, p.initial_infectious, p.initial_recovered};
+    return y0;
 }
 
-int main()
+// Function to integrate every parameter set of a sweep file at once and save one summary row per set
+bool run_sweep(const string &sweep_file, const LaneParameters &base, const EnsembleInitialState &initial, double step, double duration, int num_threads)
 {
-    // Load parameters from the file
-    unordered_map<string, double> params = load_parameters("SIR_params.txt");
-
-    // Retrieve the parameters
-    double S = 0.99;               // Initial Susceptible
-    double I = 0.01;               // Initial Infectious
-    double R = 0.0;                // Initial Recovered
-
-    double beta = 0.4;             // Initial transmission rate
-    double gamma = 0.1;            // Recovery rate
-    double dt = 0.01;              // Time step for smoother transitions
-    int total_steps = 20000;       // Simulate for 20 days
-
-    // Retrieve protective measures parameters
-    double reduced_beta = 0.25;    // Reduced transmission rate after quarantine
-    double quarantine_time = params["quarantine_time"]; // Read from file
-    double vaccination_rate = params["vaccination_rate"]; // Read from file
-    double vaccination_start = params["vaccination_start"]; // Read from file
-    double vaccination_speed = params["vaccination_speed"]; // Read from file
+    EnsembleParameters sweep;
+    string error;
+    if (!read_parameter_sweep(sweep_file, base, sweep, error))
+    {
+        cerr << "Error: " << error << endl;
+        return false;
+    }
 
-    // Open a file to log the results
-    ofstream data_file("SIR_simulation_results.csv");
-    data_file << "Time,Susceptible,Infectious,Recovered\n";
+    ThreadPool pool(num_threads);
+    EnsembleSummary summary;
+    integrate_ensemble(sweep, initial, false, step, static_cast<int>(duration / step + 0.5), pool, summary);
+    write_ensemble_summary("SIR_sweep_results.csv", sweep, summary);
+    cout << "Integrated " << sweep.size() << " parameter sets. Summary saved to " << result_filename("SIR_sweep_results.csv") << endl;
+    return true;
+}
 
-    // Simulation loop to iterate over time
-    for (int t = 0; t <= total_steps; ++t)
+// Function to integrate the SIR model and write one row per logged time
+bool run(const SirParameters &p, ResultSink &out, const RunContext &context)
+{
+    IntegratorKind integrator = static_cast<IntegratorKind>(p.integrator);
+    double step = p.step > 0.0 ? p.step : p.dt;
+
+    out.row("Time", "Susceptible", "Infectious", "Recovered");
+    out.set_format(FixedFormat, 4);
+
+    // Quarantine reduces the transmission rate and vaccination switches to its rollout speed
+    // at fixed times; both are breakpoints the integrator must not step across
+    array<double, 3> y = {{p.initial_susceptible, p.initial_infectious, p.initial_recovered}};
+    vector<double> breakpoints;
+    breakpoints.push_back(p.quarantine_time);
+    breakpoints.push_back(p.vaccination_start);
+
+    int t = 0;
+    bool integrated = integrate(
+        [&](double time, const array<double, 3> &state, array<double, 3> &dydt)
+        {
+            double current_beta = (time >= p.quarantine_time) ? p.reduced_beta : p.beta;
+            double current_vaccination = (time >= p.vaccination_start) ? p.vaccination_speed : p.vaccination_rate;
+            sir_model(state, dydt, current_beta, p.gamma, current_vaccination);
+        },
+        y, uniform_grid(0.0, p.dt, p.total_steps), breakpoints, default_integrator_options(integrator, step),
+        [&](double current_time, const array<double, 3> &state)
+        {
+            // Log data to the results
+            log_data(out, current_time, state[0], state[1], state[2]);
+
+            // Print to console for real-time monitoring
+            if (context.log && t % 100 == 0)
+            {
+                *context.log << "Time: " << current_time << " S: " << state[0] << " I: " << state[1] << " R: " << state[2] << endl;
+            }
+            ++t;
+            return context.proceed(static_cast<double>(t) / (p.total_steps + 1));
+        });
+    if (!integrated)
     {
-        double current_time = t * dt;
+        if (context.log) *context.log << "Error: " << integration_failure << endl;
+        return false;
+    }
+    return !context.cancelled();
+}
 
-        // Implement quarantine (reduce transmission rate after certain time)
-        if (current_time >= quarantine_time && current_time < quarantine_time + 0.1)
-        {
-            beta = reduced_beta; // Gradually reduce beta
-        }
+// Function to load params over the defaults and run the SIR model; false if they are invalid
+bool run(const ParameterSet &params, ResultSink &out, const RunContext &context)
+{
+    SirParameters p;
+    string error;
+    if (!load_parameters(sir_schema, params, p, error))
+    {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return run(p, out, context);
+}
 
-        // Implement vaccination after a certain time
-        if (current_time >= vaccination_start)
-        {
-            vaccination_rate = vaccination_speed;
-        }
+} // namespace sir
 
-        // Log data to the file
-        log_data(data_file, current_time, S, I, R);
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char *argv[])
+{
+    using namespace sir;
+
+    // Load parameters from the file over the defaults
+    SirParameters p;
+    string error;
+    if (!load_parameter_file(sir_schema, "SIR_params.txt", p, error))
+    {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
 
-        // Update the values using the SIR model
-        sir_model(S, I, R, beta, gamma, vaccination_rate, dt);
+    // --integrator euler|rk4|dopri5 picks the method (default dopri5); --step sets the
+    // fixed (or initial adaptive) step, which defaults to the logging interval.
+    // --sweep FILE integrates every parameter set in FILE as one ensemble on --threads N threads.
+    // --output-format columnar writes .col files instead of CSV
+    select_result_format(argc, argv);
+    string sweep_file;
+    int num_threads = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--integrator" && i + 1 < argc) p.integrator = parse_integrator(argv[++i], static_cast<IntegratorKind>(p.integrator));
+        else if (arg == "--step" && i + 1 < argc) p.step = atof(argv[++i]);
+        else if (arg == "--sweep" && i + 1 < argc) sweep_file = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) num_threads = atoi(argv[++i]);
+    }
 
-        // Print to console for real-time monitoring
-        if (t % 100 == 0)
-        {
-            cout << "Time: " << current_time << " S: " << S << " I: " << I << " R: " << R << endl;
-        }
+    if (!sweep_file.empty())
+    {
+        return run_sweep(sweep_file, lane_parameters(p), initial_state(p), p.step > 0.0 ? p.step : 0.1, p.total_steps * p.dt, num_threads) ? 0 : 1;
     }
 
+    // Open a file to log the results
+    unique_ptr<ResultSink> data_file = open_result_sink("SIR_simulation_results.csv");
+    RunContext context;
+    context.log = &cout;
+    bool completed = run(p, *data_file, context);
+
     // Close the file
-    data_file.close();
-    cout << "Simulation complete. Data saved to sir_simulation_results.csv" << endl;
+    data_file->close();
+    if (!completed) return 1;
+    cout << "Simulation complete. Data saved to " << result_filename("SIR_simulation_results.csv") << endl;
 
     return 0;
 }
+#endif
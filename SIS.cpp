@@ -1,120 +1,162 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
-#include <unordered_map>
 #include <string>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "ode_integrators.h"
+#include "compartment_model.h"
+#include "result_sink.h"
+#include "params.h"
+#include "simulation_engine.h"
 
 using namespace std;
 
-// Function to update values of S (Susceptible) and I (Infectious) using Euler's method
-void sis_model(double& S, double& I, double beta, double gamma, double dt, 
+namespace sis {
+
+// vaccination_factor is the share of susceptibles vaccinated per this many time units
+const double vaccination_interval = 0.1;
+
+// Function to compute the rates of change of S (Susceptible) and I (Infectious)
+void sis_model(const array<double, 2>& y, array<double, 2>& dydt, double beta, double gamma,
                double avoid_contact_factor, double health_checkup_factor, 
                double vaccination_factor, double safe_practices_factor) {
     
     // Adjust beta and gamma using the behavioral factors
     double effective_beta = beta * (1.0 - avoid_contact_factor) * (1.0 - safe_practices_factor); // Reduce beta for Avoid Contact and Safe Practices
     double adjusted_gamma = gamma * (1.0 + health_checkup_factor);  // Increase gamma for Health Check-ups
-    S = S * (1.0 - vaccination_factor);  // Directly reduce the susceptible population based on vaccination
-    
-    // Compute changes in S and I
-    double dS = -effective_beta * S * I + adjusted_gamma * I;
-    double dI = effective_beta * S * I - adjusted_gamma * I;
-
-    // Update S and I based on the time step
-    S += dS * dt;
-    I += dI * dt;
-
-    // Ensure S and I remain within [0, 1]
-    if (S < 0) S = 0;
-    if (I < 0) I = 0;
-    if (S > 1) S = 1;
-    if (I > 1) I = 1;
-}
 
-// Function to load parameters from a file
-unordered_map<string, double> load_params_from_file(const string& filename) {
-    unordered_map<string, double> params;
-    ifstream file(filename);
-
-    if (file.is_open()) {
-        string key;
-        double value;
-        while (file >> key >> value) {
-            params[key] = value;
-        }
-        file.close();
-    } else {
-        cerr << "Error: Could not open the file " << filename << endl;
-    }
+    // Vaccination removes a fraction vaccination_factor of the susceptibles every vaccination_interval,
+    // i.e. exponential removal at rate -ln(1 - vaccination_factor) / vaccination_interval.
+    // vaccination_factor = 1 vaccinates every susceptible at once: run_simulation empties S up
+    // front and S stays at 0, since anyone who recovers is vaccinated straight away
+    bool vaccinate_all = vaccination_factor >= 1.0;
+    double vaccination_rate = vaccinate_all ? 0.0 : -log(1.0 - vaccination_factor) / vaccination_interval;
 
-    return params;
+    // Compute changes in S and I
+    SisModel::Kernel::Rates rates = {{effective_beta, adjusted_gamma, vaccination_rate}};
+    SisModel::Kernel::rhs(y, dydt, rates);
+    if (vaccinate_all) dydt[0] = 0.0;
 }
 
-// Function to run the simulation and store results
-void run_simulation(double beta, double gamma, double dt, int total_steps, 
+// Function to run the simulation and store results; false if the integration failed
+bool run_simulation(double beta, double gamma, double dt, int total_steps, 
                     double avoid_contact_factor, double health_checkup_factor, 
-                    double vaccination_factor, double safe_practices_factor, 
-                    vector<pair<double, double>>& results) {
+                    double vaccination_factor, double safe_practices_factor, const array<double, 2>& initial_state,
+                    const IntegratorOptions& options, vector<pair<double, double>>& results, const RunContext& context) {
     
-    double S = 0.99;  // Initial Susceptible population
-    double I = 0.01;  // Initial Infectious population
-
-    for (int t = 0; t <= total_steps; ++t) {
-        results.push_back(make_pair(S, I));  // Store results at each time step
-        sis_model(S, I, beta, gamma, dt, avoid_contact_factor, health_checkup_factor, vaccination_factor, safe_practices_factor);  // Update S and I using the SIS model
-
-        // Debug: Print values for verification
-        cout << "Step " << t << ": S = " << S << ", I = " << I << endl;
-    }
+    array<double, 2> y = initial_state;  // Initial Susceptible and Infectious populations
+    if (vaccination_factor >= 1.0) y[0] = 0.0;  // Every susceptible is vaccinated at the start
+    int t = 0;
+
+    return integrate(
+        [&](double, const array<double, 2>& state, array<double, 2>& dydt) {
+            sis_model(state, dydt, beta, gamma, avoid_contact_factor, health_checkup_factor, vaccination_factor, safe_practices_factor);
+        },
+        y, uniform_grid(0.0, dt, total_steps), vector<double>(), options,
+        [&](double, const array<double, 2>& state) {
+            // Ensure S and I remain within [0, 1]
+            double S = min(max(state[0], 0.0), 1.0);
+            double I = min(max(state[1], 0.0), 1.0);
+            results.push_back(make_pair(S, I));  // Store results at each time step
+
+            // Debug: Print values for verification
+            if (context.log) *context.log << "Step " << t << ": S = " << S << ", I = " << I << endl;
+            ++t;
+            return context.proceed(static_cast<double>(t) / (total_steps + 1));
+        });
 }
 
-// Function to save results to a file for further analysis
-void save_results_to_file(const vector<pair<double, double>>& results, const string& filename) {
-    ofstream file(filename.c_str());  // Use c_str() for compatibility
-    if (file.is_open()) {
-        file << "Time,Susceptible,Infectious\n";
-        for (size_t i = 0; i < results.size(); ++i) {
-            file << i * 0.1 << "," << results[i].first << "," << results[i].second << "\n";
-        }
-        file.close();
-        cout << "Results saved to " << filename << endl;
-    } else {
-        cout << "Unable to open file for writing.\n";
+// Function to write the results with their time stamps
+void save_results(const vector<pair<double, double>>& results, double dt, ResultSink& file) {
+    file.row("Time", "Susceptible", "Infectious");
+    for (size_t i = 0; i < results.size(); ++i) {
+        file.row(i * dt, results[i].first, results[i].second);
     }
 }
 
-int main() {
-    // Load parameters from the file
-    unordered_map<string, double> params = load_params_from_file("SIS_params.txt");
-
-    // Set default model parameters
-    double beta = 0.3;  // Default infection rate
-    double gamma = 0.1; // Default recovery rate
-    double dt = 0.1;    // Default time step
-    int total_steps = 100;  // Default number of iterations
-
-    // Retrieve behavioral factors from the file
-    double avoid_contact_factor = params["avoid_contact_factor"];
-    double health_checkup_factor = params["health_checkup_factor"];
-    double vaccination_factor = params["vaccination_factor"];
-    double safe_practices_factor = params["safe_practices_factor"];
+// Function to integrate the SIS model and write one row per logged time
+bool run(const SisParameters& p, ResultSink& out, const RunContext& context) {
+    IntegratorKind integrator = static_cast<IntegratorKind>(p.integrator);
+    double step = p.step > 0.0 ? p.step : p.dt;
 
     // Debug: Print parameters to verify
-    cout << "Parameters loaded:\n";
-    cout << "beta: " << beta << ", gamma: " << gamma << ", dt: " << dt << ", total_steps: " << total_steps << endl;
-    cout << "avoid_contact_factor: " << avoid_contact_factor 
-         << ", health_checkup_factor: " << health_checkup_factor 
-         << ", vaccination_factor: " << vaccination_factor 
-         << ", safe_practices_factor: " << safe_practices_factor << endl;
+    if (context.log) {
+        *context.log << "Parameters loaded:\n";
+        *context.log << "beta: " << p.beta << ", gamma: " << p.gamma << ", dt: " << p.dt << ", total_steps: " << p.total_steps << endl;
+        *context.log << "avoid_contact_factor: " << p.avoid_contact_factor 
+                     << ", health_checkup_factor: " << p.health_checkup_factor 
+                     << ", vaccination_factor: " << p.vaccination_factor 
+                     << ", safe_practices_factor: " << p.safe_practices_factor << endl;
+    }
 
     // Vector to store results
     vector<pair<double, double>> results;
 
     // Run the simulation
-    run_simulation(beta, gamma, dt, total_steps, avoid_contact_factor, health_checkup_factor, vaccination_factor, safe_practices_factor, results);
+    array<double, 2> y0 = {{p.initial_susceptible, p.initial_infectious}};
+    if (!run_simulation(p.beta, p.gamma, p.dt, p.total_steps, p.avoid_contact_factor, p.health_checkup_factor, p.vaccination_factor,
+                        p.safe_practices_factor, y0, default_integrator_options(integrator, step), results, context)) {
+        if (context.log) *context.log << "Error: " << integration_failure << endl;
+        return false;
+    }
+
+    save_results(results, p.dt, out);
+    return !context.cancelled();
+}
+
+// Function to load params over the defaults and run the SIS model; false if they are invalid
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context) {
+    SisParameters p;
+    string error;
+    if (!load_parameters(sis_schema, params, p, error)) {
+        if (context.log) *context.log << "Error: " << error << endl;
+        return false;
+    }
+    return run(p, out, context);
+}
+
+}  // namespace sis
+
+#ifndef EPIDEMIC_LIBRARY
+int main(int argc, char* argv[]) {
+    using namespace sis;
 
-    // Save results to a file
-    save_results_to_file(results, "SIS_simulation_results.csv");
+    // --output-format columnar writes SIS_simulation_results.col instead of CSV
+    select_result_format(argc, argv);
+
+    // Load parameters from the file over the defaults
+    SisParameters p;
+    string error;
+    if (!load_parameter_file(sis_schema, "SIS_params.txt", p, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    // --integrator euler|rk4|dopri5 picks the method (default dopri5); --step sets the
+    // fixed (or initial adaptive) step, which defaults to the logging interval
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--integrator" && i + 1 < argc) p.integrator = parse_integrator(argv[++i], static_cast<IntegratorKind>(p.integrator));
+        else if (arg == "--step" && i + 1 < argc) p.step = atof(argv[++i]);
+    }
+
+    // Run the simulation and save results to a file
+    string filename = "SIS_simulation_results.csv";
+    unique_ptr<ResultSink> file = open_result_sink(filename);
+    if (file->is_open()) {
+        RunContext context;
+        context.log = &cout;
+        bool completed = run(p, *file, context);
+        file->close();
+        if (!completed) return 1;
+        cout << "Results saved to " << result_filename(filename) << endl;
+    } else {
+        cout << "Unable to open file for writing.\n";
+    }
 
     return 0;
 }
+#endif
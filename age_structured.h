@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Age-structured SEIR.
+//
+// The population is split into age bands with population shares N_a. The force of infection on
+// band a is
+//
+//     lambda_a = beta * sum_b C[a][b] * I_b / N_b
+//
+// where C[a][b] is the relative contact rate of a person in band a with band b. With
+// proportional mixing (C[a][b] = N_b for every a) this reduces to beta * I, the homogeneous SEIR.
+// Vaccination is age-targeted: band a is vaccinated at priority_a times the current rate.
+//
+// The state is a std::vector holding the S, E, I and R blocks of all bands one after another,
+// so the ODE integrators can advance it directly.
+
+// Contact matrix stored column by column. Each column is padded with zeros to a whole number of
+// row tiles, so the product kernel runs without remainder loops.
+class ContactMatrix {
+public:
+    static const size_t row_tile = 32;  // Rows accumulated together in vector registers
+
+    ContactMatrix() : bands(0), padded(0) {}
+
+    explicit ContactMatrix(size_t num_bands)
+        : bands(num_bands), padded((num_bands + row_tile - 1) / row_tile * row_tile),
+          values(padded * num_bands, 0.0) {}
+
+    size_t size() const { return bands; }
+    size_t stride() const { return padded; }
+
+    double& at(size_t row, size_t column) { return values[column * padded + row]; }
+    double at(size_t row, size_t column) const { return values[column * padded + row]; }
+
+    // out[a] = sum_b C[a][b] * x[b] for every band; out must hold stride() values
+    void multiply(const double* __restrict x, double* __restrict out) const {
+        for (size_t a0 = 0; a0 < padded; a0 += row_tile) {
+            // A tile of rows keeps its accumulators in registers while the columns stream
+            // through; the independent rows hide the latency of the multiply-adds
+            double acc[row_tile];
+            for (size_t k = 0; k < row_tile; ++k) acc[k] = 0.0;
+            const double* __restrict column = values.data() + a0;
+            for (size_t b = 0; b < bands; ++b, column += padded) {
+                double xb = x[b];
+                for (size_t k = 0; k < row_tile; ++k) acc[k] += column[k] * xb;
+            }
+            for (size_t k = 0; k < row_tile; ++k) out[a0 + k] = acc[k];
+        }
+    }
+
+private:
+    size_t bands;
+    size_t padded;
+    std::vector<double> values;
+};
+
+// Parameters of the age-structured model; band-level vectors have one entry per band
+struct AgeStructuredSeir {
+    ContactMatrix contacts;
+    std::vector<double> population;  // Population share of each band (sums to 1)
+    std::vector<double> priority;    // Vaccination rate multiplier of each band
+    double beta, reduced_beta, sigma, gamma;
+    double quarantine_time, vaccination_rate, vaccination_start, vaccination_speed;
+
+    size_t bands() const { return contacts.size(); }
+
+    // Compartment blocks of the state vector
+    static const int S = 0, E = 1, I = 2, R = 3;
+    size_t offset(int compartment) const { return compartment * bands(); }
+
+    // Initial state: the given overall fractions split across bands by population share
+    std::vector<double> initial_state(double S0, double E0, double I0, double R0) const {
+        size_t n = bands();
+        std::vector<double> y(4 * n);
+        for (size_t a = 0; a < n; ++a) {
+            y[a] = S0 * population[a];
+            y[n + a] = E0 * population[a];
+            y[2 * n + a] = I0 * population[a];
+            y[3 * n + a] = R0 * population[a];
+        }
+        return y;
+    }
+
+    // Right-hand side; scratch buffers are reused across calls so a step does not allocate
+    void rhs(double t, const std::vector<double>& y, std::vector<double>& dydt) {
+        size_t n = bands();
+        prevalence.resize(contacts.stride());
+        force.resize(contacts.stride());
+
+        const double* Sa = &y[0];
+        const double* Ea = Sa + n;
+        const double* Ia = Ea + n;
+        for (size_t b = 0; b < n; ++b) prevalence[b] = population[b] > 0.0 ? Ia[b] / population[b] : 0.0;
+        contacts.multiply(prevalence.data(), force.data());
+
+        double current_beta = (t >= quarantine_time) ? reduced_beta : beta;
+        double current_vaccination = (t >= vaccination_start) ? vaccination_speed : vaccination_rate;
+
+        double* dS = &dydt[0];
+        double* dE = dS + n;
+        double* dI = dE + n;
+        double* dR = dI + n;
+        for (size_t a = 0; a < n; ++a) {
+            double infection = current_beta * force[a] * Sa[a];
+            double vaccinated = current_vaccination * priority[a] * Sa[a];
+            double onset = sigma * Ea[a];
+            double recovery = gamma * Ia[a];
+            dS[a] = -infection - vaccinated;
+            dE[a] = infection - onset;
+            dI[a] = onset - recovery;
+            dR[a] = recovery + vaccinated;
+        }
+    }
+
+private:
+    std::vector<double> prevalence, force;
+};
+
+namespace age_detail {
+
+// Parse one CSV cell as a finite, non-negative number; blanks around it are allowed
+inline bool parse_cell(const std::string& cell, double& value) {
+    const char* text = cell.c_str();
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && std::strspn(end, " \t\r") == std::strlen(end) && std::isfinite(value) && value >= 0.0;
+}
+
+}  // namespace age_detail
+
+// Read a square contact matrix from a CSV file with one row per band and no header.
+// Returns false if the file cannot be read, a cell is not a non-negative number or the
+// matrix is not square.
+inline bool read_contact_matrix(const std::string& filename, ContactMatrix& out) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::vector<std::vector<double> > rows;
+    std::string line, cell;
+    while (std::getline(file, line)) {
+        if (line.empty() || line == "\r") continue;
+        std::vector<double> row;
+        std::stringstream ss(line);
+        double value;
+        while (std::getline(ss, cell, ',')) {
+            if (!age_detail::parse_cell(cell, value)) return false;
+            row.push_back(value);
+        }
+        rows.push_back(row);
+    }
+    if (rows.empty()) return false;
+
+    out = ContactMatrix(rows.size());
+    for (size_t a = 0; a < rows.size(); ++a) {
+        if (rows[a].size() != rows.size()) return false;
+        for (size_t b = 0; b < rows.size(); ++b) out.at(a, b) = rows[a][b];
+    }
+    return true;
+}
+
+// Read the band table: a CSV with header "population,vaccination_priority" and one row per band.
+// Population shares are normalised to sum to 1. Returns false if the file cannot be read or a
+// cell is not a non-negative number.
+inline bool read_age_bands(const std::string& filename, std::vector<double>& population, std::vector<double>& priority) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::string line, cell;
+    std::getline(file, line);  // Header
+    population.clear();
+    priority.clear();
+    while (std::getline(file, line)) {
+        if (line.empty() || line == "\r") continue;
+        std::stringstream ss(line);
+        double share, band_priority = 1.0;
+        std::getline(ss, cell, ',');
+        if (!age_detail::parse_cell(cell, share)) return false;
+        if (std::getline(ss, cell, ',') && !age_detail::parse_cell(cell, band_priority)) return false;
+        population.push_back(share);
+        priority.push_back(band_priority);
+    }
+
+    double total = 0.0;
+    for (size_t a = 0; a < population.size(); ++a) total += population[a];
+    if (total <= 0.0) return false;
+    for (size_t a = 0; a < population.size(); ++a) population[a] /= total;
+    return true;
+}
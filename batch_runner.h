@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "random_streams.h"
+#include "result_cache.h"
+#include "result_sink.h"
+#include "simulation_engine.h"
+#include "sweep_design.h"
+#include "thread_pool.h"
+
+// Batch runs of a sweep inside one process.
+//
+// Every scenario of the sweep is one block of the thread pool, so an idle thread always takes
+// the next scenario that has not started and long runs do not hold up short ones. The rows of
+// all scenarios go to one columnar result store (see columnar_file.h):
+//
+//   Scenario    index of the scenario in the sweep
+//   <swept>     one column per swept parameter, holding the scenario's value
+//   seed        the scenario's seed, for models that read one
+//   ...         the model's own result columns
+//
+// Scenarios are written in index order whatever order they finish in, each as one chunk, so
+// chunk k of the store's index holds exactly the rows of scenario k and a reader can map one
+// scenario without touching the others. The store is identical for any thread count. With a
+// ResultCache, scenarios already run by an earlier batch or the GUI are loaded instead.
+//
+// A sweep with fork_at runs the shared prefix once, on the whole pool, and then the scenarios
+// as branches of it. Every scenario then has the sweep's seed, and the cache is not used, as
+// a branch's results depend on the fork as well as on its own parameters.
+
+struct BatchSummary {
+    size_t scenarios;
+    size_t completed;  // Scenarios whose run finished
+    size_t cached;     // Scenarios loaded from the result cache
+    double seconds;
+};
+
+// Seed of a scenario for the stochastic models. Kept to 53 bits, so the value survives being
+// passed as a double through the ParameterSet.
+inline uint64_t scenario_seed(uint64_t sweep_seed, size_t scenario) {
+    return mix64(sweep_seed ^ mix64(scenario)) >> 11;
+}
+
+// Writes finished scenarios to the store in index order
+class BatchStore {
+public:
+    BatchStore(const std::string& filename, const SweepSpec& spec, bool seeded)
+        : sink(filename, static_cast<size_t>(-1)), spec(spec), seeded(seeded), header_written(false) {}
+
+    bool is_open() const { return sink.is_open(); }
+
+    void write(size_t scenario, const ParameterSet& params, const ResultTable& results) {
+        // A run that failed before writing anything leaves no columns, so the header comes from
+        // the first scenario that has them
+        if (results.headers.empty()) return;
+        if (!header_written) write_header(results.headers);
+
+        std::vector<double> swept(spec.dimensions.size());
+        for (size_t d = 0; d < swept.size(); ++d) swept[d] = params.at(spec.dimensions[d].name);
+        long long seed = seeded ? static_cast<long long>(params.at("seed")) : 0;
+        for (size_t r = 0; r < results.rows(); ++r) {
+            sink.field(static_cast<long long>(scenario));
+            for (size_t d = 0; d < swept.size(); ++d) sink.field(swept[d]);
+            if (seeded) sink.field(seed);
+            for (size_t c = 0; c < results.columns.size(); ++c) sink.field(results.columns[c][r]);
+            sink.end_row();
+        }
+        sink.flush();  // Closes the scenario's chunk
+    }
+
+    void close() {
+        if (!header_written) write_header(std::vector<std::string>());
+        sink.close();
+    }
+
+private:
+    void write_header(const std::vector<std::string>& model_columns) {
+        header_written = true;
+        sink.field("Scenario");
+        for (size_t d = 0; d < spec.dimensions.size(); ++d) sink.field(spec.dimensions[d].name);
+        if (seeded) sink.field("seed");
+        for (size_t c = 0; c < model_columns.size(); ++c) sink.field(model_columns[c]);
+        sink.end_row();
+    }
+
+    ColumnarResultSink sink;
+    const SweepSpec& spec;
+    bool seeded;
+    bool header_written;
+};
+
+// Run every scenario of spec on pool and write the store to filename. Progress lines go to
+// log and results are looked up in and added to cache, if given. Returns false, with the
+// reason in error, if the fork cannot be made or the store cannot be written.
+inline bool run_batch(const SweepSpec& spec, const std::string& filename, ThreadPool& pool, std::ostream* log,
+                      ResultCache* cache, BatchSummary& summary, std::string& error) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const ModelEntry* model = find_model(spec.model);
+    if (!model) {
+        error = "unknown model " + spec.model;
+        return false;
+    }
+
+    std::vector<ParameterSet> scenarios = expand_sweep(spec);
+    bool seeded = model_reads(*model, "seed");
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        if (seeded) scenarios[i]["seed"] = static_cast<double>(spec.fork_at > 0 ? spec.seed : scenario_seed(spec.seed, i));
+        // The pool already keeps every thread busy with whole scenarios
+        if (model_reads(*model, "num_threads") && !spec.fixed.count("num_threads")) scenarios[i]["num_threads"] = 1;
+    }
+
+    // A branch changes only the swept parameters (and its thread count) of the fork
+    std::shared_ptr<const ForkPoint> fork;
+    std::vector<ParameterSet> changes;
+    if (spec.fork_at > 0) {
+        ParameterSet baseline = spec.fixed;
+        if (seeded) baseline["seed"] = static_cast<double>(spec.seed);
+        if (model->fork) fork = model->fork(baseline, spec.fork_at, RunContext(), error);
+        else error = spec.model + " runs cannot fork";
+        if (!fork) return false;
+        changes.resize(scenarios.size());
+        for (size_t i = 0; i < scenarios.size(); ++i) {
+            for (size_t d = 0; d < spec.dimensions.size(); ++d) {
+                changes[i][spec.dimensions[d].name] = scenarios[i].at(spec.dimensions[d].name);
+            }
+            if (scenarios[i].count("num_threads")) changes[i]["num_threads"] = scenarios[i].at("num_threads");
+        }
+    }
+
+    BatchStore store(filename, spec, seeded);
+    if (!store.is_open()) {
+        error = "could not write " + filename;
+        return false;
+    }
+
+    summary.scenarios = scenarios.size();
+    summary.completed = 0;
+    summary.cached = 0;
+    std::mutex mutex;
+    std::map<size_t, std::pair<bool, ResultTable> > finished;  // Waiting for earlier scenarios
+    std::atomic<size_t> cached(0);
+    size_t next_to_write = 0;
+    bool writing = false;
+    size_t report_every = (scenarios.size() + 9) / 10;
+
+    pool.run_blocks(scenarios.size(), [&](size_t i) {
+        std::pair<bool, ResultTable> result;
+        if (fork) {
+            TableResultSink sink(result.second);
+            result.first = model->branch(*fork, changes[i], sink, RunContext());
+        } else if (cache) {
+            bool hit = false;
+            result.first = run_model_cached(*cache, spec.model, scenarios[i], result.second, RunContext(), &hit);
+            if (hit) ++cached;
+        } else {
+            result.first = run_model(spec.model, scenarios[i], result.second);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished[i] = std::move(result);
+        // One thread at a time writes, taking every scenario that is next in line
+        if (writing) return;
+        writing = true;
+        for (;;) {
+            std::map<size_t, std::pair<bool, ResultTable> >::iterator it = finished.find(next_to_write);
+            if (it == finished.end()) break;
+            std::pair<bool, ResultTable> next = std::move(it->second);
+            finished.erase(it);
+            size_t scenario = next_to_write++;
+            if (next.first) ++summary.completed;
+
+            lock.unlock();
+            store.write(scenario, scenarios[scenario], next.second);
+            if (log && ((scenario + 1) % report_every == 0 || scenario + 1 == scenarios.size())) {
+                *log << "Scenarios written: " << scenario + 1 << " of " << scenarios.size() << std::endl;
+            }
+            lock.lock();
+        }
+        writing = false;
+    });
+
+    store.close();
+    summary.cached = cached.load();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "mapped_file.h"
+
+// Binary checkpoint files, written in the background.
+//
+// A checkpoint is an 8-byte magic naming its format, the payload the model packs with
+// CheckpointBuffer, and a u64 FNV-1a checksum of everything before it. Values are stored in
+// host order, which like the columnar files must be little-endian.
+//
+// The model copies its state into a CheckpointBuffer between steps, which costs one memory
+// copy; CheckpointWriter then writes, syncs and renames the file on its own thread while the
+// simulation goes on. A write goes to a temporary file that replaces the checkpoint only once
+// it is complete on disk, so a crash at any point leaves the previous checkpoint intact.
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "checkpoints are stored in host order, which must be little-endian");
+#endif
+
+inline uint64_t checkpoint_checksum(const unsigned char* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Bytes of a checkpoint under construction
+class CheckpointBuffer {
+public:
+    explicit CheckpointBuffer(const char magic[8]) { bytes.insert(bytes.end(), magic, magic + 8); }
+
+    template <typename T>
+    void put(T value) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    // A u64 element count followed by the elements
+    template <typename T>
+    void put_array(const std::vector<T>& values) {
+        put<uint64_t>(values.size());
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(values.data());
+        bytes.insert(bytes.end(), p, p + values.size() * sizeof(T));
+    }
+
+    void put_string(const std::string& text) {
+        put<uint16_t>(static_cast<uint16_t>(text.size()));
+        bytes.insert(bytes.end(), text.begin(), text.end());
+    }
+
+    // Append the checksum and hand over the finished file
+    std::vector<unsigned char> finish() {
+        put<uint64_t>(checkpoint_checksum(bytes.data(), bytes.size()));
+        return std::move(bytes);
+    }
+
+private:
+    std::vector<unsigned char> bytes;
+};
+
+// Reads back a checkpoint through a memory mapping. Every get fails, rather than reading past
+// the end, once the file runs out; check ok() after unpacking.
+class CheckpointReader {
+public:
+    CheckpointReader() : position(0), valid(false) {}
+
+    // Map the file and check its magic and checksum. Returns false if it is not a complete
+    // checkpoint of the given format.
+    bool open(const std::string& filename, const char magic[8]) {
+        position = 0;
+        valid = mapping.open(filename) && mapping.size() >= 16 && std::memcmp(mapping.data(), magic, 8) == 0;
+        if (!valid) return false;
+        uint64_t stored;
+        std::memcpy(&stored, mapping.data() + mapping.size() - 8, 8);
+        valid = stored == checkpoint_checksum(mapping.data(), mapping.size() - 8);
+        position = 8;
+        return valid;
+    }
+
+    bool ok() const { return valid; }
+
+    template <typename T>
+    bool get(T& value) {
+        if (!take(sizeof(T))) return false;
+        std::memcpy(&value, mapping.data() + position - sizeof(T), sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    bool get_array(std::vector<T>& values) {
+        uint64_t count = 0;
+        if (!get(count) || count > (payload_end() - position) / sizeof(T)) return valid = false;
+        values.resize(static_cast<size_t>(count));
+        take(values.size() * sizeof(T));
+        std::memcpy(values.data(), mapping.data() + position - values.size() * sizeof(T), values.size() * sizeof(T));
+        return true;
+    }
+
+    bool get_string(std::string& text) {
+        uint16_t length = 0;
+        if (!get(length) || !take(length)) return false;
+        text.assign(reinterpret_cast<const char*>(mapping.data()) + position - length, length);
+        return true;
+    }
+
+private:
+    MappedFile mapping;
+    size_t position;
+    bool valid;
+
+    size_t payload_end() const { return mapping.size() - 8; }
+
+    bool take(size_t size) {
+        if (!valid || size > payload_end() - position) return valid = false;
+        position += size;
+        return true;
+    }
+};
+
+// Writes checkpoints on a background thread, one at a time. A new write waits for the one
+// before it, so a slow disk delays the simulation at most by the time one write takes.
+class CheckpointWriter {
+public:
+    CheckpointWriter() : failed(false), counter(0) {}
+    ~CheckpointWriter() { wait(); }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Start writing bytes to filename and return at once. Returns false if the previous write
+    // failed.
+    bool write(const std::string& filename, std::vector<unsigned char>&& bytes) {
+        bool previous_ok = wait();
+        std::string temp = filename + ".tmp" + std::to_string(getpid()) + "." + std::to_string(counter++);
+        pending = std::thread([this, filename, temp](std::vector<unsigned char> data) {
+            failed = !write_file(temp, data) || !replace(temp, filename);
+        }, std::move(bytes));
+        return previous_ok;
+    }
+
+    // Wait for the write in progress, if any. Returns false if it failed.
+    bool wait() {
+        if (pending.joinable()) pending.join();
+        bool ok = !failed;
+        failed = false;
+        return ok;
+    }
+
+private:
+    std::thread pending;
+    bool failed;  // Set by the writing thread, read after joining it
+    uint64_t counter;
+
+    static bool write_file(const std::string& filename, const std::vector<unsigned char>& data) {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size() && std::fflush(file) == 0 &&
+                  fsync(fileno(file)) == 0;
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok) std::remove(filename.c_str());
+        return ok;
+    }
+
+    static bool replace(const std::string& temp, const std::string& filename) {
+        std::error_code ec;
+        std::filesystem::rename(temp, filename, ec);
+        if (ec) std::remove(temp.c_str());
+        return !ec;
+    }
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+// Binary columnar result files (.col).
+//
+// Layout, all integers little-endian and every section 8-byte aligned:
+//
+//   header   "EPICOLS1", u32 column count, u32 header size in bytes, then per column
+//            u8 type, u8 reserved, u16 name length and the name; zero-padded to 8 bytes
+//   chunks   u64 row count, then each column's values for those rows as one contiguous
+//            array of 8-byte int64 or float64 values
+//   index    per chunk: u64 file offset, u64 first row, u64 row count
+//   footer   u64 chunk count, u64 total rows, u64 index offset, "EPICOLIX"
+//
+// The index and footer are written when the file is closed. A file cut short by a crash has
+// no footer; the reader then walks the complete chunks from the header instead. Columns are
+// read in place from the mapping, so loading costs page faults rather than parsing.
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "columnar files are stored in host order, which must be little-endian");
+#endif
+
+enum ColumnType : uint8_t { Int64Column = 0, Float64Column = 1 };
+
+namespace columnar {
+
+const char header_magic[8] = {'E', 'P', 'I', 'C', 'O', 'L', 'S', '1'};
+const char footer_magic[8] = {'E', 'P', 'I', 'C', 'O', 'L', 'I', 'X'};
+const size_t footer_bytes = 32;
+const size_t index_entry_bytes = 24;
+
+inline size_t padded_to_8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+}  // namespace columnar
+
+// Read-only view of a columnar file through a memory mapping
+class ColumnarFile {
+public:
+    struct Chunk {
+        uint64_t first_row;
+        uint64_t row_count;
+        size_t offset;  // File offset of the chunk's first column
+    };
+
+    ColumnarFile() : base(nullptr), length(0), header_size(0), total_rows(0) {}
+    ~ColumnarFile() { close(); }
+
+    ColumnarFile(const ColumnarFile&) = delete;
+    ColumnarFile& operator=(const ColumnarFile&) = delete;
+
+    // Map the file and read its header and chunk index. Returns false if the file cannot be
+    // opened or is not a columnar file.
+    bool open(const std::string& filename) {
+        close();
+        if (!mapping.open(filename) || mapping.size() < 16) {
+            mapping.close();
+            return false;
+        }
+        base = mapping.data();
+        length = mapping.size();
+
+        if (!read_header() || !read_chunks()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        mapping.close();
+        base = nullptr;
+        length = 0;
+        total_rows = 0;
+        names.clear();
+        types.clear();
+        chunk_list.clear();
+    }
+
+    bool is_open() const { return base != nullptr; }
+    size_t columns() const { return names.size(); }
+    uint64_t rows() const { return total_rows; }
+    const std::string& name(size_t column) const { return names[column]; }
+    ColumnType type(size_t column) const { return types[column]; }
+    const std::vector<Chunk>& chunks() const { return chunk_list; }
+
+    // Index of the column with the given name, or -1
+    int find_column(const std::string& column_name) const {
+        for (size_t c = 0; c < names.size(); ++c) {
+            if (names[c] == column_name) return static_cast<int>(c);
+        }
+        return -1;
+    }
+
+    // Values of a column within one chunk, read in place; check type() first
+    const double* real_values(size_t column, size_t chunk) const {
+        return reinterpret_cast<const double*>(column_data(column, chunk));
+    }
+    const int64_t* integer_values(size_t column, size_t chunk) const {
+        return reinterpret_cast<const int64_t*>(column_data(column, chunk));
+    }
+
+    // A whole column converted to double
+    std::vector<double> column_as_double(size_t column) const {
+        std::vector<double> out(total_rows);
+        for (size_t k = 0; k < chunk_list.size(); ++k) {
+            double* dest = out.data() + chunk_list[k].first_row;
+            size_t n = chunk_list[k].row_count;
+            if (types[column] == Float64Column) {
+                std::memcpy(dest, real_values(column, k), n * sizeof(double));
+            } else {
+                const int64_t* values = integer_values(column, k);
+                for (size_t i = 0; i < n; ++i) dest[i] = static_cast<double>(values[i]);
+            }
+        }
+        return out;
+    }
+
+private:
+    MappedFile mapping;
+    const unsigned char* base;
+    size_t length;
+    size_t header_size;
+    uint64_t total_rows;
+    std::vector<std::string> names;
+    std::vector<ColumnType> types;
+    std::vector<Chunk> chunk_list;
+
+    template <typename T>
+    T load(size_t offset) const {
+        T value;
+        std::memcpy(&value, base + offset, sizeof(T));
+        return value;
+    }
+
+    const unsigned char* column_data(size_t column, size_t chunk) const {
+        return base + chunk_list[chunk].offset + column * chunk_list[chunk].row_count * 8;
+    }
+
+    bool read_header() {
+        if (std::memcmp(base, columnar::header_magic, 8) != 0) return false;
+        uint32_t column_count = load<uint32_t>(8);
+        header_size = load<uint32_t>(12);
+        if (header_size < 16 || header_size > length) return false;
+
+        size_t offset = 16;
+        for (uint32_t c = 0; c < column_count; ++c) {
+            if (offset + 4 > header_size) return false;
+            uint8_t type = load<uint8_t>(offset);
+            uint16_t name_length = load<uint16_t>(offset + 2);
+            offset += 4;
+            if (type > Float64Column || offset + name_length > header_size) return false;
+            types.push_back(static_cast<ColumnType>(type));
+            names.push_back(std::string(reinterpret_cast<const char*>(base + offset), name_length));
+            offset += name_length;
+        }
+        return true;
+    }
+
+    // Use the chunk index when the footer is intact, otherwise walk the complete chunks
+    bool read_chunks() {
+        size_t row_bytes = names.size() * 8;
+        if (length >= header_size + columnar::footer_bytes &&
+            std::memcmp(base + length - 8, columnar::footer_magic, 8) == 0) {
+            size_t footer = length - columnar::footer_bytes;
+            uint64_t chunk_count = load<uint64_t>(footer);
+            total_rows = load<uint64_t>(footer + 8);
+            uint64_t index_offset = load<uint64_t>(footer + 16);
+            // Every size below is checked by division so that no corrupt value can overflow
+            if (index_offset < header_size || index_offset > footer ||
+                (footer - index_offset) % columnar::index_entry_bytes != 0 ||
+                (footer - index_offset) / columnar::index_entry_bytes != chunk_count) {
+                return false;
+            }
+
+            // The chunks must lie between the header and the index and tile [0, total_rows) in
+            // order, so column_as_double writes each row exactly once and within bounds
+            uint64_t covered = 0;
+            for (uint64_t k = 0; k < chunk_count; ++k) {
+                size_t entry = index_offset + k * columnar::index_entry_bytes;
+                uint64_t chunk_start = load<uint64_t>(entry);
+                Chunk chunk = {load<uint64_t>(entry + 8), load<uint64_t>(entry + 16), 0};
+                if (chunk_start < header_size || chunk_start > index_offset - 8 ||
+                    load<uint64_t>(chunk_start) != chunk.row_count) {
+                    return false;
+                }
+                chunk.offset = static_cast<size_t>(chunk_start) + 8;
+                if (row_bytes > 0 && chunk.row_count > (index_offset - chunk.offset) / row_bytes) return false;
+                if (chunk.row_count > total_rows || chunk.first_row > total_rows - chunk.row_count ||
+                    chunk.first_row != covered) {
+                    return false;
+                }
+                covered += chunk.row_count;
+                chunk_list.push_back(chunk);
+            }
+            return covered == total_rows;
+        }
+
+        size_t offset = header_size;
+        total_rows = 0;
+        while (offset + 8 <= length) {
+            uint64_t row_count = load<uint64_t>(offset);
+            if (row_count == 0 || (row_bytes > 0 && row_count > (length - offset - 8) / row_bytes)) break;
+            Chunk chunk = {total_rows, row_count, offset + 8};
+            chunk_list.push_back(chunk);
+            total_rows += row_count;
+            offset += 8 + row_count * row_bytes;
+        }
+        return true;
+    }
+};
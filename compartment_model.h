@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Compartmental models described at compile time.
+//
+// A model is a list of compartments and a list of flows between them. Each flow moves people
+// from one compartment to another (or out of the system) at a rate given by a rate law, and the
+// right-hand side is generated from that description: every flow is expanded inline into two
+// fused updates, with no virtual calls, loops over flow tables or allocation. The generated
+// rhs() has the signature the integrators in ode_integrators.h expect once the current
+// parameters are bound.
+//
+// Example (the SIR model with vaccination):
+//
+//     enum Compartment { S, I, R, compartments };
+//     enum Parameter { Beta, Gamma, Vaccination, parameters };
+//     typedef CompartmentModel<compartments, parameters,
+//                              Flow<S, I, MassAction<Beta, I> >,
+//                              Flow<I, R, Linear<Gamma> >,
+//                              Flow<S, R, Linear<Vaccination> > > Kernel;
+//
+// Flows are applied in the order listed, so the floating-point results are reproducible.
+
+// Destination of flows that leave the modelled population (removal, deaths not tracked)
+const size_t outside = static_cast<size_t>(-1);
+
+namespace compartment_detail {
+
+// Sum of the listed compartments (at least one)
+template <size_t... Indices>
+struct SumOf;
+
+template <size_t First, size_t... Rest>
+struct SumOf<First, Rest...> {
+    template <size_t N>
+    static double of(const std::array<double, N>& y) {
+        static_assert(First < N, "compartment index out of range");
+        return y[First] + SumOf<Rest...>::of(y);
+    }
+};
+
+template <size_t Only>
+struct SumOf<Only> {
+    template <size_t N>
+    static double of(const std::array<double, N>& y) {
+        static_assert(Only < N, "compartment index out of range");
+        return y[Only];
+    }
+};
+
+// Adds a flux to its destination; flows to `outside` only drain their source
+template <size_t To>
+struct Inflow {
+    template <size_t N>
+    static void add(std::array<double, N>& dydt, double flux) {
+        static_assert(To < N, "compartment index out of range");
+        dydt[To] += flux;
+    }
+};
+
+template <>
+struct Inflow<outside> {
+    template <size_t N>
+    static void add(std::array<double, N>&, double) {}
+};
+
+}  // namespace compartment_detail
+
+// Rate laws. flux<From>(y, p) is the number moved per unit time out of compartment From.
+
+// Constant per-capita rate: p[Rate] * y[From]
+template <size_t Rate>
+struct Linear {
+    template <size_t From, size_t N, size_t P>
+    static double flux(const std::array<double, N>& y, const std::array<double, P>& p) {
+        static_assert(Rate < P, "parameter index out of range");
+        return p[Rate] * y[From];
+    }
+};
+
+// Mass-action infection: p[Rate] * y[From] * (sum of the infectious compartments)
+template <size_t Rate, size_t... Infectious>
+struct MassAction {
+    template <size_t From, size_t N, size_t P>
+    static double flux(const std::array<double, N>& y, const std::array<double, P>& p) {
+        static_assert(Rate < P, "parameter index out of range");
+        return p[Rate] * y[From] * compartment_detail::SumOf<Infectious...>::of(y);
+    }
+};
+
+// Flow from compartment From to compartment To (or `outside`) following rate law Law
+template <size_t From, size_t To, typename Law>
+struct Flow {
+    template <size_t N, size_t P>
+    static void apply(const std::array<double, N>& y, std::array<double, N>& dydt, const std::array<double, P>& p) {
+        static_assert(From < N, "compartment index out of range");
+        double flux = Law::template flux<From>(y, p);
+        dydt[From] -= flux;
+        compartment_detail::Inflow<To>::add(dydt, flux);
+    }
+};
+
+// A model with the given number of compartments and parameters and its list of flows
+template <size_t Compartments, size_t Parameters, typename... Flows>
+struct CompartmentModel {
+    typedef std::array<double, Compartments> State;
+    typedef std::array<double, Parameters> Rates;
+
+    // dydt = sum of all flows at state y with parameters p
+    static void rhs(const State& y, State& dydt, const Rates& p) {
+        dydt.fill(0.0);
+        int expand[] = {0, (Flows::apply(y, dydt, p), 0)...};
+        (void)expand;
+    }
+};
+
+// Model catalogue. Each entry names its compartments and parameters (in index order) for
+// logging and parameter files, and gives defaults for a standalone run.
+
+// Susceptible-Infectious-Recovered with vaccination moving S straight to R
+struct SirModel {
+    enum Compartment { S, I, R, compartments };
+    enum Parameter { Beta, Gamma, Vaccination, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, I, MassAction<Beta, I> >,
+                             Flow<I, R, Linear<Gamma> >,
+                             Flow<S, R, Linear<Vaccination> > > Kernel;
+
+    static const char* name() { return "SIR"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Infectious", "Recovered"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "gamma", "vaccination_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.4, 0.1, 0.0}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.99, 0.01, 0.0}}; return y; }
+};
+
+// SIR with a latent (exposed) stage
+struct SeirModel {
+    enum Compartment { S, E, I, R, compartments };
+    enum Parameter { Beta, Sigma, Gamma, Vaccination, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, E, MassAction<Beta, I> >,
+                             Flow<E, I, Linear<Sigma> >,
+                             Flow<I, R, Linear<Gamma> >,
+                             Flow<S, R, Linear<Vaccination> > > Kernel;
+
+    static const char* name() { return "SEIR"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Exposed", "Infectious", "Recovered"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "sigma", "gamma", "vaccination_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.6, 0.1, 0.2, 0.0}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.94, 0.01, 0.05, 0.0}}; return y; }
+};
+
+// Susceptible-Infectious-Susceptible; vaccinated susceptibles leave the modelled population
+struct SisModel {
+    enum Compartment { S, I, compartments };
+    enum Parameter { Beta, Gamma, Vaccination, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, I, MassAction<Beta, I> >,
+                             Flow<I, S, Linear<Gamma> >,
+                             Flow<S, outside, Linear<Vaccination> > > Kernel;
+
+    static const char* name() { return "SIS"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Infectious"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "gamma", "vaccination_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.3, 0.1, 0.0}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.99, 0.01}}; return y; }
+};
+
+// SEIR with waning immunity returning recovered people to S
+struct SeirsModel {
+    enum Compartment { S, E, I, R, compartments };
+    enum Parameter { Beta, Sigma, Gamma, Waning, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, E, MassAction<Beta, I> >,
+                             Flow<E, I, Linear<Sigma> >,
+                             Flow<I, R, Linear<Gamma> >,
+                             Flow<R, S, Linear<Waning> > > Kernel;
+
+    static const char* name() { return "SEIRS"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Exposed", "Infectious", "Recovered"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "sigma", "gamma", "waning_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.6, 0.1, 0.2, 0.01}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.94, 0.01, 0.05, 0.0}}; return y; }
+};
+
+// SEIR with deaths out of the infectious compartment
+struct SeirdModel {
+    enum Compartment { S, E, I, R, D, compartments };
+    enum Parameter { Beta, Sigma, Gamma, Mortality, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, E, MassAction<Beta, I> >,
+                             Flow<E, I, Linear<Sigma> >,
+                             Flow<I, R, Linear<Gamma> >,
+                             Flow<I, D, Linear<Mortality> > > Kernel;
+
+    static const char* name() { return "SEIRD"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Exposed", "Infectious", "Recovered", "Dead"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "sigma", "gamma", "mortality_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.6, 0.1, 0.2, 0.005}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.94, 0.01, 0.05, 0.0, 0.0}}; return y; }
+};
+
+// SIR with a vaccinated compartment whose protection wanes back to S
+struct SirvModel {
+    enum Compartment { S, I, R, V, compartments };
+    enum Parameter { Beta, Gamma, Vaccination, Waning, parameters };
+    typedef CompartmentModel<compartments, parameters,
+                             Flow<S, I, MassAction<Beta, I> >,
+                             Flow<I, R, Linear<Gamma> >,
+                             Flow<S, V, Linear<Vaccination> >,
+                             Flow<V, S, Linear<Waning> > > Kernel;
+
+    static const char* name() { return "SIRV"; }
+    static const char* compartment_name(size_t c) {
+        static const char* const names[] = {"Susceptible", "Infectious", "Recovered", "Vaccinated"};
+        return names[c];
+    }
+    static const char* parameter_name(size_t p) {
+        static const char* const names[] = {"beta", "gamma", "vaccination_rate", "waning_rate"};
+        return names[p];
+    }
+    static Kernel::Rates default_parameters() { Kernel::Rates p = {{0.4, 0.1, 0.01, 0.005}}; return p; }
+    static Kernel::State initial_state() { Kernel::State y = {{0.99, 0.01, 0.0, 0.0}}; return y; }
+};
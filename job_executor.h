@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "simulation_engine.h"
+#include "result_stream.h"
+#include "result_cache.h"
+
+// Background execution of model runs for the GUI.
+//
+// The GUI thread submits jobs and, once per frame, polls for finished ones; a single worker
+// thread runs them one after another through run_model(). Jobs and results travel through
+// single-producer single-consumer ring buffers, so neither side ever waits on the other: the
+// GUI keeps drawing while a run is in progress. Each job has a JobStatus that the run updates
+// with its progress and that the GUI sets to cancel it. A job may also stream its rows to a
+// ResultStream as they are produced. With a ResultCache, a job whose results are cached
+// returns them without running.
+
+// Bounded queue for exactly one producer thread and one consumer thread. push and pop never
+// block or lock; they fail instead when the queue is full or empty.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side
+    bool push(T&& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = advance(t);
+        if (next == head.load(std::memory_order_acquire)) return false;  // Full
+        slots[t] = std::move(value);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;  // Empty
+        value = std::move(slots[h]);
+        head.store(advance(h), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+    std::vector<T> slots;                   // One slot stays free to tell full from empty
+    alignas(64) std::atomic<size_t> head;   // Next slot to pop; written by the consumer only
+    alignas(64) std::atomic<size_t> tail;   // Next slot to push; written by the producer only
+
+    size_t advance(size_t i) const { return i + 1 == slots.size() ? 0 : i + 1; }
+};
+
+// State of a submitted job shared by the GUI and the worker
+struct JobStatus {
+    std::atomic<float> progress;  // Fraction done, updated by the running model
+    std::atomic<bool> running;    // The worker has started the job and not yet finished it
+    std::atomic<bool> cancel;     // Set by the GUI to stop the job, or to skip it if still queued
+
+    JobStatus() : progress(0.0f), running(false), cancel(false) {}
+};
+
+// A finished job
+struct JobResult {
+    uint64_t id;
+    std::string model;
+    bool completed;      // False if the job was cancelled or the model failed
+    bool cached;         // The results came from the cache
+    double seconds;      // Wall time of the run
+    ResultTable results;
+};
+
+class JobExecutor {
+public:
+    explicit JobExecutor(size_t capacity = 16, ResultCache* cache = nullptr)
+        : requests(capacity), finished(capacity), cache(cache), next_id(1), stopping(false) {
+        worker = std::thread([this] { worker_loop(); });
+    }
+
+    // Finishes the running job, if any; queued jobs are dropped
+    ~JobExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    JobExecutor(const JobExecutor&) = delete;
+    JobExecutor& operator=(const JobExecutor&) = delete;
+
+    // Queue a run of the named model, optionally streaming its rows. Returns its status, or null
+    // if the queue is full. Call from one thread only.
+    std::shared_ptr<JobStatus> submit(const std::string& model, const ParameterSet& params, uint64_t* id = nullptr,
+                                      std::shared_ptr<ResultStream> stream = nullptr) {
+        Job job;
+        job.id = next_id;
+        job.model = model;
+        job.params = params;
+        job.status = std::make_shared<JobStatus>();
+        job.stream = stream;
+        std::shared_ptr<JobStatus> status = job.status;
+        if (!requests.push(std::move(job))) return nullptr;
+        if (id) *id = next_id;
+        ++next_id;
+
+        // The lock only orders this notification with the worker going to sleep
+        { std::lock_guard<std::mutex> lock(wake_mutex); }
+        wake.notify_one();
+        return status;
+    }
+
+    // Take the next finished job, if there is one. Never blocks; call from one thread only.
+    bool poll(JobResult& result) { return finished.pop(result); }
+
+private:
+    struct Job {
+        uint64_t id;
+        std::string model;
+        ParameterSet params;
+        std::shared_ptr<JobStatus> status;
+        std::shared_ptr<ResultStream> stream;
+    };
+
+    SpscQueue<Job> requests;       // GUI -> worker
+    SpscQueue<JobResult> finished; // Worker -> GUI
+    ResultCache* cache;            // Null for none
+    uint64_t next_id;
+    std::thread worker;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void worker_loop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping) return;
+            }
+            while (requests.pop(job)) {
+                JobResult result = run(job);
+                // The GUI drains results every frame, so a full queue clears quickly
+                while (!finished.push(std::move(result))) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                if (stopping) return;
+            }
+        }
+    }
+
+    JobResult run(const Job& job) {
+        JobResult result;
+        result.id = job.id;
+        result.model = job.model;
+        result.completed = false;
+        result.cached = false;
+        result.seconds = 0.0;
+        if (job.status->cancel.load()) return result;
+
+        RunContext context;
+        context.progress = &job.status->progress;
+        context.cancel = &job.status->cancel;
+        job.status->running.store(true);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (cache && cache->load(job.model, job.params, result.results)) {
+            result.completed = result.cached = true;
+            if (job.stream) stream_table(result.results, *job.stream, &job.status->cancel);
+            job.status->progress.store(1.0f);
+        } else if (job.stream) {
+            StreamingResultSink sink(result.results, *job.stream, &job.status->cancel);
+            result.completed = run_model(job.model, job.params, sink, context);
+        } else {
+            result.completed = run_model(job.model, job.params, result.results, context);
+        }
+        if (cache && result.completed && !result.cached) cache->store(job.model, job.params, result.results);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        job.status->running.store(false);
+        return result;
+    }
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <imgui.h>
+#include "result_stream.h"
+
+// Time-series plot of a run in progress, drawn with the ImGui draw list.
+//
+// The first column of the stream is the x-axis and every other column is a series. Each frame,
+// update() takes only the rows that arrived since the previous frame and folds them into
+// per-series buckets of consecutive samples, each keeping its min, max and which of the two came
+// first.
+// When the buckets outnumber max_buckets, neighbours are merged and the bucket width doubles,
+// so a series costs at most 2 * max_buckets points to draw however long the run gets, and the
+// envelope still shows every spike.
+class LivePlot {
+public:
+    explicit LivePlot(size_t max_buckets = 512)
+        : max_buckets(max_buckets), per_bucket(1), in_last_bucket(0), rows(0) {}
+
+    ~LivePlot() { detach(); }
+
+    LivePlot(const LivePlot&) = delete;
+    LivePlot& operator=(const LivePlot&) = delete;
+
+    // Start plotting a new stream; the previous one is released
+    void attach(const std::shared_ptr<ResultStream>& new_stream) {
+        detach();
+        stream = new_stream;
+        names.clear();
+        series.clear();
+        x.clear();
+        per_bucket = 1;
+        in_last_bucket = 0;
+        rows = 0;
+    }
+
+    bool empty() const { return rows == 0; }
+    size_t samples() const { return rows; }
+
+    // Fold in the rows produced since the last call
+    void update() {
+        if (!stream || !stream->ready()) return;
+        if (names.empty()) {
+            names = stream->headers();
+            series.assign(names.size() > 1 ? names.size() - 1 : 0, std::vector<Bucket>());
+        }
+        size_t width = names.size();
+        if (width == 0) return;
+
+        incoming.clear();
+        size_t count = stream->read(incoming);
+        for (size_t r = 0; r < count; ++r) add_row(&incoming[r * width]);
+    }
+
+    // Draw the plot with its legend at the cursor, filling size
+    void draw(const ImVec2& size) {
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        ImVec2 p0 = ImGui::GetCursorScreenPos();
+        ImVec2 p1(p0.x + size.x, p0.y + size.y);
+        draw_list->AddRectFilled(p0, p1, IM_COL32(25, 25, 30, 255));
+        draw_list->AddRect(p0, p1, IM_COL32(90, 90, 100, 255));
+        ImGui::Dummy(size);
+        if (rows == 0) return;
+
+        // Axis ranges over everything seen so far
+        float x_min = x.front(), x_max = x.back();
+        float y_min = INFINITY, y_max = -INFINITY;
+        for (size_t s = 0; s < series.size(); ++s) {
+            for (size_t b = 0; b < series[s].size(); ++b) {
+                if (series[s][b].lo < y_min) y_min = series[s][b].lo;
+                if (series[s][b].hi > y_max) y_max = series[s][b].hi;
+            }
+        }
+        if (!(y_min <= y_max)) y_min = y_max = 0.0f;
+        if (x_max <= x_min) x_max = x_min + 1.0f;
+        if (y_max <= y_min) y_max = y_min + 1.0f;
+
+        const float margin = 6.0f;
+        float left = p0.x + margin, right = p1.x - margin, top = p0.y + margin, bottom = p1.y - margin;
+        float sx = (right - left) / (x_max - x_min);
+        float sy = (bottom - top) / (y_max - y_min);
+
+        static const ImU32 palette[] = {IM_COL32(102, 194, 255, 255), IM_COL32(255, 127, 80, 255),
+                                        IM_COL32(144, 238, 144, 255), IM_COL32(238, 130, 238, 255),
+                                        IM_COL32(255, 215, 0, 255), IM_COL32(64, 224, 208, 255),
+                                        IM_COL32(240, 128, 128, 255), IM_COL32(200, 200, 200, 255)};
+        const size_t colors = sizeof(palette) / sizeof(palette[0]);
+
+        for (size_t s = 0; s < series.size(); ++s) {
+            points.clear();
+            for (size_t b = 0; b < series[s].size(); ++b) {
+                const Bucket& bucket = series[s][b];
+                if (std::isnan(bucket.lo)) continue;
+                float px = left + (x[b] - x_min) * sx;
+                // Draw the envelope in the order the extremes were reached
+                float a = bucket.low_first ? bucket.lo : bucket.hi;
+                float c = bucket.low_first ? bucket.hi : bucket.lo;
+                points.push_back(ImVec2(px, bottom - (a - y_min) * sy));
+                if (c != a) points.push_back(ImVec2(px, bottom - (c - y_min) * sy));
+            }
+            if (points.size() > 1) {
+                draw_list->AddPolyline(points.data(), static_cast<int>(points.size()), palette[s % colors], 0, 1.5f);
+            }
+        }
+
+        // Axis limits in the corners
+        char label[64];
+        ImU32 text = IM_COL32(200, 200, 200, 255);
+        std::snprintf(label, sizeof(label), "%g", y_max);
+        draw_list->AddText(ImVec2(left, top), text, label);
+        std::snprintf(label, sizeof(label), "%g", y_min);
+        draw_list->AddText(ImVec2(left, bottom - ImGui::GetTextLineHeight()), text, label);
+        std::snprintf(label, sizeof(label), "%s %g", names[0].c_str(), x_max);
+        draw_list->AddText(ImVec2(right - ImGui::CalcTextSize(label).x, bottom - ImGui::GetTextLineHeight()), text, label);
+
+        // Legend
+        for (size_t s = 0; s < series.size(); ++s) {
+            ImVec2 box = ImGui::GetCursorScreenPos();
+            float h = ImGui::GetTextLineHeight();
+            draw_list->AddRectFilled(ImVec2(box.x, box.y + h * 0.25f), ImVec2(box.x + h * 0.5f, box.y + h * 0.75f), palette[s % colors]);
+            ImGui::Dummy(ImVec2(h * 0.5f, h));
+            ImGui::SameLine();
+            ImGui::Text("%s", names[s + 1].c_str());
+            if (s + 1 < series.size()) ImGui::SameLine();
+        }
+    }
+
+private:
+    struct Bucket {
+        float lo, hi;    // NaN until the bucket holds a number
+        bool low_first;  // The minimum was reached before the maximum
+    };
+
+    size_t max_buckets;
+    size_t per_bucket;      // Samples per bucket; doubles on every merge
+    size_t in_last_bucket;  // Samples already in the last bucket
+    size_t rows;
+    std::shared_ptr<ResultStream> stream;
+    std::vector<std::string> names;
+    std::vector<std::vector<Bucket> > series;
+    std::vector<float> x;   // x of each bucket's first sample
+    std::vector<double> incoming;
+    std::vector<ImVec2> points;
+
+    void detach() {
+        if (stream) stream->detach();
+        stream.reset();
+    }
+
+    void add_row(const double* row) {
+        if (in_last_bucket == per_bucket || x.empty()) {
+            if (x.size() == max_buckets) merge();
+            if (in_last_bucket == per_bucket || x.empty()) {
+                x.push_back(static_cast<float>(row[0]));
+                for (size_t s = 0; s < series.size(); ++s) series[s].push_back(Bucket{NAN, NAN, true});
+                in_last_bucket = 0;
+            }
+        }
+        for (size_t s = 0; s < series.size(); ++s) {
+            float v = static_cast<float>(row[s + 1]);
+            if (std::isnan(v)) continue;
+            Bucket& bucket = series[s].back();
+            // A new extreme is the latest one reached, so it comes after the other
+            if (std::isnan(bucket.lo)) {
+                bucket.lo = bucket.hi = v;
+            } else if (v < bucket.lo) {
+                bucket.lo = v;
+                bucket.low_first = false;
+            } else if (v > bucket.hi) {
+                bucket.hi = v;
+                bucket.low_first = true;
+            }
+        }
+        ++in_last_bucket;
+        ++rows;
+    }
+
+    // Halve the number of buckets by merging neighbours
+    void merge() {
+        size_t merged = (x.size() + 1) / 2;
+        for (size_t b = 0; b < merged; ++b) {
+            x[b] = x[2 * b];
+            for (size_t s = 0; s < series.size(); ++s) {
+                Bucket m = series[s][2 * b];
+                if (2 * b + 1 < series[s].size()) m = combine(m, series[s][2 * b + 1]);
+                series[s][b] = m;
+            }
+        }
+        // An odd last bucket keeps filling; otherwise the last merged bucket is full
+        bool odd = x.size() % 2 == 1;
+        x.resize(merged);
+        for (size_t s = 0; s < series.size(); ++s) series[s].resize(merged);
+        in_last_bucket = odd ? in_last_bucket : 2 * per_bucket;
+        per_bucket *= 2;
+    }
+
+    static Bucket combine(const Bucket& a, const Bucket& b) {
+        if (std::isnan(a.lo)) return b;
+        if (std::isnan(b.lo)) return a;
+        // Ties keep the earlier bucket's extreme; b follows a
+        bool low_from_a = a.lo <= b.lo, high_from_a = a.hi >= b.hi;
+        bool low_first = low_from_a == high_from_a ? (low_from_a ? a.low_first : b.low_first) : low_from_a;
+        Bucket m = {low_from_a ? a.lo : b.lo, high_from_a ? a.hi : b.hi, low_first};
+        return m;
+    }
+};
@@ -7,6 +7,10 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include "simulation_engine.h"
+#include "job_executor.h"
+#include "result_cache.h"
+#include "live_plot.h"
 
 using namespace std;
 
@@ -29,7 +33,8 @@ void write_parameters_to_file(const string &filename, const vector<pair<string,
     cout << "Parameters saved to " << filename << endl;
 }
 
-void display_gui()
+// Runs are submitted to executor; active_job is the run whose results the window waits for
+void display_gui(JobExecutor &executor, shared_ptr<JobStatus> &active_job)
 {
     static int model_selection = 0;
     const char *models[] = {"SEIR", "SIR", "SIS", "ABM", "Branching", "MARKONIKOV"};
@@ -45,12 +50,17 @@ void display_gui()
     static float safe_practices_factor = 0.4f;
     static float infection_prob = 0.8f;
     static float recovery_prob = 0.7f;
+    static float quarantine_prob = 1.0f;
     static float protective_measures_rate = 0.0f;
+    static int seed = 0; // Stochastic models only; 0 draws a fresh seed for every run
 
     vector<pair<string, double>> params; // To store parameter key-value pairs
     string filename;                     // Parameter file name
-    string cpp_filename;                 // C++ file name to compile and execute
-    string csv_filename; // CSV file for the selected model
+
+    // Live plot of the last run, fed while the run is in progress
+    static string results_model;
+    static LivePlot plot;
+    static uint64_t active_id = 0;
 
     // Display inputs dynamically based on the selected model
     switch (model_selection)
@@ -66,8 +76,6 @@ void display_gui()
             {"vaccination_start", vaccination_start},
             {"vaccination_speed", vaccination_speed}};
         filename = "SEIR_params.txt";
-        cpp_filename = "SEIR.cpp";
-        csv_filename = "SEIR_simulation_results.csv";
         break;
 
     case 1: // SIR
@@ -81,8 +89,6 @@ void display_gui()
             {"vaccination_start", vaccination_start},
             {"vaccination_speed", vaccination_speed}};
         filename = "SIR_params.txt";
-        cpp_filename = "SIR.cpp";
-        csv_filename = "SIR_simulation_results.csv";
         break;
 
     case 2: // SIS
@@ -96,36 +102,30 @@ void display_gui()
             {"vaccination_factor", vaccination_rate},
             {"safe_practices_factor", safe_practices_factor}};
         filename = "SIS_params.txt";
-        cpp_filename = "SIS.cpp";
-        csv_filename = "SIS_simulation_results.csv";
         break;
 
     case 3: // ABM
         ImGui::SliderFloat("Infection Probability", &infection_prob, 0.0f, 1.0f);
         ImGui::SliderFloat("Recovery Probability", &recovery_prob, 0.0f, 1.0f);
         ImGui::SliderFloat("Vaccination Probability", &vaccination_rate, 0.0f, 1.0f);
-        ImGui::SliderFloat("Quarantine Probability", &quarantine_time, 0.0f, 1.0f);
+        ImGui::SliderFloat("Quarantine Probability", &quarantine_prob, 0.0f, 1.0f);
         params = {
             {"infection_prob", infection_prob},
             {"recovery_prob", recovery_prob},
             {"vaccination_prob", vaccination_rate},
-            {"quarantine_prob", quarantine_time}};
+            {"quarantine_prob", quarantine_prob}};
         filename = "ABM_params.txt";
-        cpp_filename = "ABM.cpp";
-        csv_filename = "ABM_simulation_results.csv";
         break;
 
     case 4: // Branching
         ImGui::SliderFloat("Vaccination Probability", &vaccination_rate, 0.0f, 1.0f);
-        ImGui::SliderFloat("Quarantine Probability", &quarantine_time, 0.0f, 1.0f);
+        ImGui::SliderFloat("Quarantine Probability", &quarantine_prob, 0.0f, 1.0f);
         ImGui::SliderFloat("Safe Practices Probability", &safe_practices_factor, 0.0f, 1.0f);
         params = {
             {"vaccination_prob", vaccination_rate},
-            {"quarantine_prob", quarantine_time},
+            {"quarantine_prob", quarantine_prob},
             {"safe_practices_prob", safe_practices_factor}};
         filename = "Branching_params.txt";
-        cpp_filename = "SEIR.cpp";
-        csv_filename = "Branching_simulation_results.csv";
         break;
 
     case 5: // MARKONIKOV
@@ -135,49 +135,81 @@ void display_gui()
             {"vaccination_rate", vaccination_rate},
             {"protective_measures_rate", protective_measures_rate}};
         filename = "MARKONIKOV_params.txt";
-        cpp_filename = "MARKOV_PROCESS_SIR.cpp";
-        csv_filename = "MARKONIKOV_simulation_results.csv";
         break;
     }
 
+    // A fixed seed makes a stochastic run repeatable, so it can come from the result cache
+    if (model_selection >= 3)
+    {
+        ImGui::InputInt("Seed (0 for random)", &seed);
+        if (seed > 0)
+        {
+            params.push_back({"seed", seed});
+        }
+    }
+
     if (ImGui::Button("Run Simulation"))
     {
+        write_parameters_to_file(filename, params);
+        cout << "Running " << models[model_selection] << " simulation..." << endl;
 
-        // Write selected model's CSV filename to a temporary file
-        ofstream file("selected_model_filename.txt");
-        if (file.is_open())
+        // A new run replaces the one in progress
+        if (active_job)
         {
-            file << csv_filename;
-            file.close();
+            active_job->cancel = true;
         }
-        else
+        ParameterSet run_params(params.begin(), params.end());
+        shared_ptr<ResultStream> stream = make_shared<ResultStream>();
+        active_job = executor.submit(models[model_selection], run_params, &active_id, stream);
+        if (active_job)
         {
-            cerr << "Error: Could not write to selected_model_filename.txt" << endl;
-            return;
+            results_model = models[model_selection];
+            plot.attach(stream);
         }
+        if (!active_job)
+        {
+            cerr << "Error: Too many simulations queued." << endl;
+        }
+    }
 
-        cout << "Selected model's results will be loaded from: " << csv_filename << endl;
-
-
-        write_parameters_to_file(filename, params);
-        cout << "Running " << models[model_selection] << " simulation..." << endl;
-
-        // Compile and execute the model's C++ file, then run the Python script
-        string compile_command = "g++ " + cpp_filename + " -o model_exec -std=c++11 && ./model_exec";
-        string python_command = "python3 main.py";
+    // Runs happen on the executor's thread; show progress and collect results when they finish
+    if (active_job)
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel"))
+        {
+            active_job->cancel = true;
+        }
+        ImGui::ProgressBar(active_job->progress.load(), ImVec2(-1, 0));
+    }
 
-        // Execute the commands
-        int compile_status = system(compile_command.c_str());
-        if (compile_status == 0)
+    JobResult finished;
+    while (executor.poll(finished))
+    {
+        if (finished.id != active_id)
         {
-            cout << "Model executed successfully. Generating plots..." << endl;
-            system(python_command.c_str());
+            continue; // Superseded by a later run
+        }
+        active_job.reset();
+        if (finished.completed)
+        {
+            cout << "Model executed successfully: " << finished.results.rows() << " rows in " << finished.seconds << " s"
+                 << (finished.cached ? " (cached)." : ".") << endl;
         }
         else
         {
-            cerr << "Error: Compilation or execution of the model failed." << endl;
+            cerr << "The " << finished.model << " simulation was cancelled or failed." << endl;
         }
     }
+
+    // Plot every result column except the first (time or step) as the rows arrive
+    plot.update();
+    if (!plot.empty())
+    {
+        ImGui::Separator();
+        ImGui::Text("%s results: %zu rows", results_model.c_str(), plot.samples());
+        plot.draw(ImVec2(ImGui::GetContentRegionAvail().x, 300));
+    }
 }
 
 int main()
@@ -213,6 +245,12 @@ int main()
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 120");
 
+    // Simulations run in the background so the window keeps rendering; repeated runs come
+    // from the result cache
+    ResultCache cache;
+    JobExecutor executor(16, &cache);
+    shared_ptr<JobStatus> active_job;
+
     // Main application loop
     while (!glfwWindowShouldClose(window))
     {
@@ -225,7 +263,7 @@ int main()
         ImGui::NewFrame();
 
         // Display GUI
-        display_gui();
+        display_gui(executor, active_job);
 
         // Render ImGui content
         ImGui::Render();
@@ -240,7 +278,11 @@ int main()
         glfwSwapBuffers(window);
     }
 
-    // Cleanup
+    // Cleanup; a run still in progress is stopped rather than waited for
+    if (active_job)
+    {
+        active_job->cancel = true;
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
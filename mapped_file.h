@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file (POSIX). The mapping is advised for sequential
+// access, so the kernel reads ahead while a loader walks it front to back.
+class MappedFile {
+public:
+    MappedFile() : base(nullptr), length(0), opened_empty(false) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file cannot be opened or mapped. An empty file maps to size() == 0.
+    bool open(const std::string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if (info.st_size == 0) {
+            ::close(fd);
+            opened_empty = true;
+            return true;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        base = static_cast<const unsigned char*>(mapped);
+        length = static_cast<size_t>(info.st_size);
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(const_cast<unsigned char*>(base), length);
+        base = nullptr;
+        length = 0;
+        opened_empty = false;
+    }
+
+    bool is_open() const { return base != nullptr || opened_empty; }
+    const unsigned char* data() const { return base; }
+    const char* chars() const { return reinterpret_cast<const char*>(base); }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* base;
+    size_t length;
+    bool opened_empty;
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Metapopulation SEIR over a sparse mobility network.
+//
+// Every region (node) runs its own SEIR dynamics on counts. Residents of region i spend a
+// fraction w_ij of their contacts in region j, so the force of infection on i is
+//
+//     lambda_i = beta * (stay_i * I_i / N_i + sum_{j != i} w_ij * I_j / N_j),  stay_i = 1 - sum_j w_ij
+//
+// The coupling is updated once per day: the imported term is computed from the start-of-day
+// prevalence with one sparse product, then every region integrates its day independently with
+// RK4 while its own prevalence evolves. Regions are split into contiguous blocks on the
+// ThreadPool, so a day costs one barrier regardless of the number of regions.
+
+// Mobility weights in compressed sparse row form; row i lists the regions i's residents visit
+struct MobilityMatrix {
+    std::vector<size_t> row_start;   // Row i occupies [row_start[i], row_start[i + 1])
+    std::vector<uint32_t> column;
+    std::vector<double> weight;
+
+    size_t nodes() const { return row_start.empty() ? 0 : row_start.size() - 1; }
+    size_t edges() const { return column.size(); }
+};
+
+// Build the CSR matrix from an edge list with a counting sort over the origins.
+// Self-loops are dropped; staying home is implied by the remaining weight.
+inline MobilityMatrix build_mobility_matrix(size_t nodes, const std::vector<uint32_t>& origin,
+                                            const std::vector<uint32_t>& destination, const std::vector<double>& fraction) {
+    MobilityMatrix m;
+    m.row_start.assign(nodes + 1, 0);
+    for (size_t e = 0; e < origin.size(); ++e) {
+        if (origin[e] != destination[e]) ++m.row_start[origin[e] + 1];
+    }
+    for (size_t i = 0; i < nodes; ++i) m.row_start[i + 1] += m.row_start[i];
+
+    std::vector<size_t> next(m.row_start.begin(), m.row_start.end() - 1);
+    m.column.resize(m.row_start[nodes]);
+    m.weight.resize(m.row_start[nodes]);
+    for (size_t e = 0; e < origin.size(); ++e) {
+        if (origin[e] == destination[e]) continue;
+        size_t slot = next[origin[e]]++;
+        m.column[slot] = destination[e];
+        m.weight[slot] = fraction[e];
+    }
+    return m;
+}
+
+// Epidemic parameters shared by every region
+struct MetapopulationParameters {
+    double beta, reduced_beta, sigma, gamma;
+    double quarantine_time, vaccination_rate, vaccination_start, vaccination_speed;
+    int steps_per_day;  // RK4 substeps within each day
+};
+
+// Regions per block of the daily update. The blocks depend only on the region count, so the
+// block totals, and so the daily totals, are the same for any thread count.
+const size_t regions_per_block = 256;
+
+// Totals over all regions, as fractions of the whole population
+struct MetapopulationTotals {
+    double susceptible, exposed, infectious, recovered;
+};
+
+class MetapopulationSeir {
+public:
+    MetapopulationSeir(const MobilityMatrix& mobility, const std::vector<double>& population,
+                       const MetapopulationParameters& params, ThreadPool& pool)
+        : mobility(mobility), population(population), params(params), pool(pool),
+          blocks((population.size() + regions_per_block - 1) / regions_per_block), day(0) {
+        size_t n = population.size();
+        S.assign(n, 0.0);
+        E.assign(n, 0.0);
+        I.assign(n, 0.0);
+        R.assign(n, 0.0);
+        stay.assign(n, 1.0);
+        imported.assign(n, 0.0);
+        prevalence.assign(n, 0.0);
+        peak_infectious.assign(n, 0.0);
+        peak_day.assign(n, 0);
+
+        total_population = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            total_population += population[i];
+            double away = 0.0;
+            for (size_t e = mobility.row_start[i]; e < mobility.row_start[i + 1]; ++e) away += mobility.weight[e];
+            stay[i] = std::max(0.0, 1.0 - away);
+        }
+    }
+
+    // Seed each region with the given number of infectious people; the rest are susceptible
+    void initialize(const std::vector<double>& infected) {
+        for (size_t i = 0; i < population.size(); ++i) {
+            I[i] = std::min(infected[i], population[i]);
+            S[i] = population[i] - I[i];
+            E[i] = R[i] = 0.0;
+            peak_infectious[i] = I[i];
+            peak_day[i] = 0;
+        }
+        day = 0;
+    }
+
+    // Advance every region by one day and return the new totals
+    MetapopulationTotals advance_day() {
+        size_t n = population.size();
+        for (size_t i = 0; i < n; ++i) prevalence[i] = population[i] > 0.0 ? I[i] / population[i] : 0.0;
+
+        std::vector<MetapopulationTotals> block_totals(blocks);
+        pool.parallel_for(n, blocks, [&](size_t begin, size_t end, size_t block) {
+            // Imported prevalence for the day, one sparse row per region
+            for (size_t i = begin; i < end; ++i) {
+                double sum = 0.0;
+                for (size_t e = mobility.row_start[i]; e < mobility.row_start[i + 1]; ++e) {
+                    sum += mobility.weight[e] * prevalence[mobility.column[e]];
+                }
+                imported[i] = sum;
+            }
+            integrate_block(begin, end);
+
+            MetapopulationTotals sum = {0.0, 0.0, 0.0, 0.0};
+            for (size_t i = begin; i < end; ++i) {
+                sum.susceptible += S[i];
+                sum.exposed += E[i];
+                sum.infectious += I[i];
+                sum.recovered += R[i];
+                if (I[i] > peak_infectious[i]) {
+                    peak_infectious[i] = I[i];
+                    peak_day[i] = day + 1;
+                }
+            }
+            block_totals[block] = sum;
+        });
+        ++day;
+
+        // Reduce in block order so the totals do not depend on the thread count
+        MetapopulationTotals totals = {0.0, 0.0, 0.0, 0.0};
+        for (size_t b = 0; b < block_totals.size(); ++b) {
+            totals.susceptible += block_totals[b].susceptible;
+            totals.exposed += block_totals[b].exposed;
+            totals.infectious += block_totals[b].infectious;
+            totals.recovered += block_totals[b].recovered;
+        }
+        totals.susceptible /= total_population;
+        totals.exposed /= total_population;
+        totals.infectious /= total_population;
+        totals.recovered /= total_population;
+        return totals;
+    }
+
+    size_t nodes() const { return population.size(); }
+    int current_day() const { return day; }
+
+    // Per-region summary: largest infectious count so far and the day it was reached
+    double peak(size_t i) const { return peak_infectious[i]; }
+    int peak_at(size_t i) const { return peak_day[i]; }
+    double attack_rate(size_t i) const { return population[i] > 0.0 ? (R[i] + I[i] + E[i]) / population[i] : 0.0; }
+
+private:
+    const MobilityMatrix& mobility;
+    std::vector<double> population;
+    MetapopulationParameters params;
+    ThreadPool& pool;
+    size_t blocks;
+    int day;
+    double total_population;
+    std::vector<double> S, E, I, R;
+    std::vector<double> stay, imported, prevalence;
+    std::vector<double> peak_infectious;
+    std::vector<int> peak_day;
+
+    // RK4 over one day for regions [begin, end); regions are independent within the day
+    void integrate_block(size_t begin, size_t end) {
+        double h = 1.0 / params.steps_per_day;
+        for (int sub = 0; sub < params.steps_per_day; ++sub) {
+            double t = day + sub * h;
+            for (size_t i = begin; i < end; ++i) {
+                double y[4] = {S[i], E[i], I[i], R[i]};
+                double k1[4], k2[4], k3[4], k4[4], tmp[4];
+                rhs(i, t, y, k1);
+                for (int c = 0; c < 4; ++c) tmp[c] = y[c] + h / 2 * k1[c];
+                rhs(i, t + h / 2, tmp, k2);
+                for (int c = 0; c < 4; ++c) tmp[c] = y[c] + h / 2 * k2[c];
+                rhs(i, t + h / 2, tmp, k3);
+                for (int c = 0; c < 4; ++c) tmp[c] = y[c] + h * k3[c];
+                rhs(i, t + h, tmp, k4);
+                S[i] = y[0] + h / 6 * (k1[0] + 2 * k2[0] + 2 * k3[0] + k4[0]);
+                E[i] = y[1] + h / 6 * (k1[1] + 2 * k2[1] + 2 * k3[1] + k4[1]);
+                I[i] = y[2] + h / 6 * (k1[2] + 2 * k2[2] + 2 * k3[2] + k4[2]);
+                R[i] = y[3] + h / 6 * (k1[3] + 2 * k2[3] + 2 * k3[3] + k4[3]);
+            }
+        }
+    }
+
+    void rhs(size_t i, double t, const double* y, double* dydt) const {
+        double current_beta = (t >= params.quarantine_time) ? params.reduced_beta : params.beta;
+        double current_vaccination = (t >= params.vaccination_start) ? params.vaccination_speed : params.vaccination_rate;
+        double local = population[i] > 0.0 ? y[2] / population[i] : 0.0;
+        double lambda = current_beta * (stay[i] * local + imported[i]);
+
+        double infection = lambda * y[0];
+        double vaccinated = current_vaccination * y[0];
+        double onset = params.sigma * y[1];
+        double recovery = params.gamma * y[2];
+        dydt[0] = -infection - vaccinated;
+        dydt[1] = infection - onset;
+        dydt[2] = onset - recovery;
+        dydt[3] = recovery + vaccinated;
+    }
+};
+
+namespace metapopulation_detail {
+
+// Parse the next CSV cell of ss as a finite, non-negative number; blanks around it are allowed.
+// False if the cell is missing or malformed.
+inline bool next_cell(std::stringstream& ss, double& value) {
+    std::string cell;
+    if (!std::getline(ss, cell, ',')) return false;
+    const char* text = cell.c_str();
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && std::strspn(end, " \t\r") == std::strlen(end) && std::isfinite(value) && value >= 0.0;
+}
+
+}  // namespace metapopulation_detail
+
+// Read regions from a CSV with header "population,infected" and one row per region.
+// Returns false if the file cannot be read, lists no regions, or a region has no positive
+// population or a malformed infected count.
+inline bool read_regions(const std::string& filename, std::vector<double>& population, std::vector<double>& infected) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    std::getline(file, line);  // Header
+    population.clear();
+    infected.clear();
+    while (std::getline(file, line)) {
+        if (line.empty() || line == "\r") continue;
+        std::stringstream ss(line);
+        double people, cases = 0.0;
+        if (!metapopulation_detail::next_cell(ss, people) || people <= 0.0) return false;
+        if (!ss.eof() && !metapopulation_detail::next_cell(ss, cases)) return false;
+        population.push_back(people);
+        infected.push_back(cases);
+    }
+    return !population.empty();
+}
+
+// Read mobility edges from a CSV with header "origin,destination,fraction" (zero-based region
+// indices). Returns false if the file cannot be read, a cell is malformed, an edge names an
+// unknown region, or a region's outgoing fractions add up to more than 1 (its residents would
+// spend a negative share of their contacts at home).
+inline bool read_mobility(const std::string& filename, size_t nodes, MobilityMatrix& out) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::vector<uint32_t> origin, destination;
+    std::vector<double> fraction;
+    std::vector<double> outgoing(nodes, 0.0);
+    std::string line;
+    std::getline(file, line);  // Header
+    while (std::getline(file, line)) {
+        if (line.empty() || line == "\r") continue;
+        std::stringstream ss(line);
+        double from, to, share;
+        if (!metapopulation_detail::next_cell(ss, from) || !metapopulation_detail::next_cell(ss, to) ||
+            !metapopulation_detail::next_cell(ss, share)) {
+            return false;
+        }
+        if (from >= nodes || to >= nodes || from != std::floor(from) || to != std::floor(to)) return false;
+        origin.push_back(static_cast<uint32_t>(from));
+        destination.push_back(static_cast<uint32_t>(to));
+        fraction.push_back(share);
+        if (from != to) outgoing[origin.back()] += share;  // Self edges are dropped below
+    }
+    for (size_t i = 0; i < nodes; ++i) {
+        if (outgoing[i] > 1.0 + 1e-9) return false;
+    }
+    out = build_mobility_matrix(nodes, origin, destination, fraction);
+    return true;
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Integrators for the compartmental ODE models (SIR, SEIR, SIS).
+//
+// A model supplies its right-hand side as rhs(t, y, dydt), where the state is a std::array for
+// fixed-size models or a std::vector for models sized at run time (age-structured, spatial).
+// integrate() advances the state over
+// a requested output grid and calls observe(t, y) once per grid point, independent of the
+// internal steps taken. An observer that returns bool can stop the integration early by
+// returning false. integrate() returns false if the state stops being finite (a fixed step too
+// large for the problem) or the adaptive step size collapses (a stiff or non-finite right-hand side). Breakpoints mark times where the right-hand side jumps (interventions
+// switching on); no step crosses one, so the higher-order methods keep their accuracy.
+
+enum IntegratorKind { EulerIntegrator, Rk4Integrator, DormandPrinceIntegrator };
+
+struct IntegratorOptions {
+    IntegratorKind kind;
+    double step;   // Fixed step for Euler/RK4, initial step for Dormand-Prince
+    double rtol;   // Relative tolerance (Dormand-Prince only)
+    double atol;   // Absolute tolerance (Dormand-Prince only)
+};
+
+inline IntegratorOptions default_integrator_options(IntegratorKind kind, double step) {
+    IntegratorOptions options = {kind, step, 1e-8, 1e-10};
+    return options;
+}
+
+// Parse "euler", "rk4" or "dopri5"; anything else keeps the fallback
+inline IntegratorKind parse_integrator(const std::string& name, IntegratorKind fallback) {
+    if (name == "euler") return EulerIntegrator;
+    if (name == "rk4") return Rk4Integrator;
+    if (name == "dopri5") return DormandPrinceIntegrator;
+    return fallback;
+}
+
+// Reason to report when integrate() returns false
+const char* const integration_failure = "the state diverged or the adaptive step size collapsed before the end of the run";
+
+// Evenly spaced output grid t0, t0 + dt, ..., t0 + count * dt. Times are computed on demand,
+// so long runs do not hold the grid in memory; integrate() also accepts a std::vector of times.
+struct UniformGrid {
+    double t0;
+    double dt;
+    size_t points;
+
+    size_t size() const { return points; }
+    bool empty() const { return points == 0; }
+    double operator[](size_t k) const { return t0 + k * dt; }
+    double back() const { return (*this)[points - 1]; }
+};
+
+inline UniformGrid uniform_grid(double t0, double dt, int count) {
+    UniformGrid grid = {t0, dt, count < 0 ? 0 : static_cast<size_t>(count) + 1};
+    return grid;
+}
+
+namespace ode_detail {
+
+// Call observe(t, y); false if the observer asks to stop
+template <typename Observer, typename State>
+inline bool notify(Observer& observe, double t, const State& y) {
+    if constexpr (std::is_same<decltype(observe(t, y)), bool>::value) {
+        return observe(t, y);
+    } else {
+        observe(t, y);
+        return true;
+    }
+}
+
+template <typename State>
+inline void axpy(State& out, const State& y, double h, const State& k) {
+    const size_t n = y.size();
+    for (size_t i = 0; i < n; ++i) out[i] = y[i] + h * k[i];
+}
+
+template <typename State>
+inline bool finite(const State& y) {
+    for (size_t i = 0; i < y.size(); ++i) {
+        if (!std::isfinite(y[i])) return false;
+    }
+    return true;
+}
+
+// Next time the integrator must stop at: the next output time or breakpoint after t
+inline double next_stop(double t, double next_output, const std::vector<double>& breakpoints) {
+    double stop = next_output;
+    for (size_t b = 0; b < breakpoints.size(); ++b) {
+        if (breakpoints[b] > t && breakpoints[b] < stop) stop = breakpoints[b];
+    }
+    return stop;
+}
+
+// Fixed-step explicit Euler or classical RK4. Steps are shortened to land exactly on every
+// output time and breakpoint. Returns false as soon as a step leaves the state non-finite.
+template <typename State, typename Rhs, typename Times, typename Observer>
+bool integrate_fixed(Rhs& rhs, State& y, const Times& output_times,
+                     const std::vector<double>& breakpoints, const IntegratorOptions& options, Observer& observe) {
+    const size_t N = y.size();
+    State k1(y), k2(y), k3(y), k4(y), tmp(y);
+    double t = output_times[0];
+    if (!notify(observe, t, y)) return true;
+
+    for (size_t out = 1; out < output_times.size(); ++out) {
+        while (t < output_times[out]) {
+            double stop = next_stop(t, output_times[out], breakpoints);
+            double h = options.step;
+            bool last = (stop - t) <= h * (1.0 + 1e-9);
+            if (last) h = stop - t;
+
+            rhs(t, y, k1);
+            if (options.kind == EulerIntegrator) {
+                axpy(y, y, h, k1);
+            } else {
+                axpy(tmp, y, h / 2, k1);
+                rhs(t + h / 2, tmp, k2);
+                axpy(tmp, y, h / 2, k2);
+                rhs(t + h / 2, tmp, k3);
+                axpy(tmp, y, h, k3);
+                rhs(t + h, tmp, k4);
+                for (size_t i = 0; i < N; ++i) y[i] += h / 6 * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+            }
+            if (!finite(y)) return false;
+            t = last ? stop : t + h;
+        }
+        if (!notify(observe, output_times[out], y)) return true;
+    }
+    return true;
+}
+
+// Dormand-Prince 5(4) with FSAL, error-controlled step size and Hairer's 4th-order dense
+// output, so output times are interpolated rather than stepped to. A step is accepted only when
+// its error estimate is a number no larger than 1, so NaN steps are retried smaller. Returns
+// false once the step falls below a few ulps of the time, where no step can succeed.
+template <typename State, typename Rhs, typename Times, typename Observer>
+bool integrate_dopri5(Rhs& rhs, State& y, const Times& output_times,
+                      const std::vector<double>& breakpoints, const IntegratorOptions& options, Observer& observe) {
+    const size_t N = y.size();
+    static const double
+        a21 = 1.0 / 5,
+        a31 = 3.0 / 40, a32 = 9.0 / 40,
+        a41 = 44.0 / 45, a42 = -56.0 / 15, a43 = 32.0 / 9,
+        a51 = 19372.0 / 6561, a52 = -25360.0 / 2187, a53 = 64448.0 / 6561, a54 = -212.0 / 729,
+        a61 = 9017.0 / 3168, a62 = -355.0 / 33, a63 = 46732.0 / 5247, a64 = 49.0 / 176, a65 = -5103.0 / 18656,
+        a71 = 35.0 / 384, a73 = 500.0 / 1113, a74 = 125.0 / 192, a75 = -2187.0 / 6784, a76 = 11.0 / 84,
+        e1 = 71.0 / 57600, e3 = -71.0 / 16695, e4 = 71.0 / 1920, e5 = -17253.0 / 339200, e6 = 22.0 / 525, e7 = -1.0 / 40,
+        d1 = -12715105075.0 / 11282082432, d3 = 87487479700.0 / 32700410799, d4 = -10690763975.0 / 1880347072,
+        d5 = 701980252875.0 / 199316789632, d6 = -1453857185.0 / 822651844, d7 = 69997945.0 / 29380423;
+
+    State k1(y), k2(y), k3(y), k4(y), k5(y), k6(y), k7(y), tmp(y), y_new(y);
+    State r1(y), r2(y), r3(y), r4(y), r5(y);  // Dense output coefficients of the last accepted step
+    double t = output_times[0];
+    double t_end = output_times.back();
+    double h = options.step > 0 ? options.step : 1e-3;
+    const double min_step = 16 * std::numeric_limits<double>::epsilon() * std::max(std::fabs(t), std::fabs(t_end));
+    size_t out = 0;
+
+    if (!notify(observe, t, y)) return true;
+    ++out;
+
+    bool need_k1 = true;
+    while (out < output_times.size() && t < t_end) {
+        // Adaptive steps stop at breakpoints and the end, but never at interior output times
+        double stop = next_stop(t, t_end, breakpoints);
+        if (need_k1) {
+            rhs(t, y, k1);
+            need_k1 = false;
+        }
+        bool hits_stop = (stop - t) <= h * (1.0 + 1e-9);
+        double step = hits_stop ? stop - t : h;
+
+        for (size_t i = 0; i < N; ++i) tmp[i] = y[i] + step * (a21 * k1[i]);
+        rhs(t + step / 5, tmp, k2);
+        for (size_t i = 0; i < N; ++i) tmp[i] = y[i] + step * (a31 * k1[i] + a32 * k2[i]);
+        rhs(t + 3 * step / 10, tmp, k3);
+        for (size_t i = 0; i < N; ++i) tmp[i] = y[i] + step * (a41 * k1[i] + a42 * k2[i] + a43 * k3[i]);
+        rhs(t + 4 * step / 5, tmp, k4);
+        for (size_t i = 0; i < N; ++i) tmp[i] = y[i] + step * (a51 * k1[i] + a52 * k2[i] + a53 * k3[i] + a54 * k4[i]);
+        rhs(t + 8 * step / 9, tmp, k5);
+        for (size_t i = 0; i < N; ++i) tmp[i] = y[i] + step * (a61 * k1[i] + a62 * k2[i] + a63 * k3[i] + a64 * k4[i] + a65 * k5[i]);
+        rhs(t + step, tmp, k6);
+        for (size_t i = 0; i < N; ++i) y_new[i] = y[i] + step * (a71 * k1[i] + a73 * k3[i] + a74 * k4[i] + a75 * k5[i] + a76 * k6[i]);
+        rhs(t + step, y_new, k7);
+
+        double err = 0.0;
+        for (size_t i = 0; i < N; ++i) {
+            double e = step * (e1 * k1[i] + e3 * k3[i] + e4 * k4[i] + e5 * k5[i] + e6 * k6[i] + e7 * k7[i]);
+            double scale = options.atol + options.rtol * std::max(std::fabs(y[i]), std::fabs(y_new[i]));
+            err += (e / scale) * (e / scale);
+        }
+        err = std::sqrt(err / N);
+
+        double factor = err == 0.0 ? 10.0 : 0.9 * std::pow(err, -0.2);
+        factor = std::isnan(factor) ? 0.2 : std::min(10.0, std::max(0.2, factor));
+
+        if (!(err <= 1.0)) {
+            h = step * factor;
+            if (h < min_step) return false;
+            continue;
+        }
+
+        // Accepted: emit every output time within (t, t + step] from the dense output
+        for (size_t i = 0; i < N; ++i) {
+            double diff = y_new[i] - y[i];
+            double bspl = step * k1[i] - diff;
+            r1[i] = y[i];
+            r2[i] = diff;
+            r3[i] = bspl;
+            r4[i] = diff - step * k7[i] - bspl;
+            r5[i] = step * (d1 * k1[i] + d3 * k3[i] + d4 * k4[i] + d5 * k5[i] + d6 * k6[i] + d7 * k7[i]);
+        }
+        double t_new = hits_stop ? stop : t + step;
+        while (out < output_times.size() && output_times[out] <= t_new) {
+            double theta = (output_times[out] - t) / step;
+            double theta1 = 1.0 - theta;
+            for (size_t i = 0; i < N; ++i) {
+                tmp[i] = r1[i] + theta * (r2[i] + theta1 * (r3[i] + theta * (r4[i] + theta1 * r5[i])));
+            }
+            if (!notify(observe, output_times[out], tmp)) return true;
+            ++out;
+        }
+
+        y = y_new;
+        t = t_new;
+        if (hits_stop) {
+            need_k1 = true;  // The right-hand side may jump here, so FSAL cannot be reused
+        } else {
+            k1 = k7;
+            h = step * factor;
+        }
+    }
+    return true;
+}
+
+}  // namespace ode_detail
+
+// Integrate dy/dt = rhs(t, y, dydt) from output_times[0] and call observe(t, y) at every
+// output time (the first one included). y holds the state at the last integrated time on return.
+// If observe returns false, integration stops there. Returns false if the integration failed
+// before the last output time.
+template <typename State, typename Rhs, typename Times, typename Observer>
+bool integrate(Rhs rhs, State& y, const Times& output_times,
+               const std::vector<double>& breakpoints, const IntegratorOptions& options, Observer observe) {
+    if (output_times.empty()) return true;
+    if (options.kind == DormandPrinceIntegrator) {
+        return ode_detail::integrate_dopri5(rhs, y, output_times, breakpoints, options, observe);
+    }
+    return ode_detail::integrate_fixed(rhs, y, output_times, breakpoints, options, observe);
+}
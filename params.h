@@ -0,0 +1,485 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+// Typed parameters of every model, loaded through one schema per model.
+//
+// Each model's parameters are a flat struct of plain fields. Its schema lists every field once:
+// the name used in parameter files, its type and offset in the struct, its default and the
+// range of valid values. Loading fills the defaults, then assigns each name=value pair to its
+// field after checking the value against the range, so a misspelt name or an out-of-range
+// value is an error rather than a silently ignored line. The simulations then read plain struct
+// members.
+//
+// Parameter files hold one "name=value" per line; "name value" is accepted too. Blank lines and
+// lines starting with # are skipped.
+
+// Parameter values by name, as passed to the in-process models
+typedef std::unordered_map<std::string, double> ParameterSet;
+
+enum ParameterType {
+    RealParameter,     // double
+    IntegerParameter,  // int; values must be whole numbers
+    SeedParameter      // uint64_t; a fresh random seed when not given
+};
+
+enum ParameterFlags {
+    ResultParameter = 0,  // Changes what the model computes
+    RunSetting = 1,       // Changes only how the run executes (e.g. the thread count)
+    StateShape = 2        // Shapes the model's state, so branches of a forked run cannot change it
+};
+
+struct ParameterInfo {
+    const char* name;
+    ParameterType type;
+    size_t offset;      // Of the field in the model's parameter struct
+    double fallback;    // Default value; unused for seeds
+    double low, high;   // Valid range, both ends included
+    unsigned flags;
+    const char* description;
+};
+
+struct ParameterSchema {
+    const char* model;
+    const ParameterInfo* fields;
+    size_t count;
+
+    const ParameterInfo* begin() const { return fields; }
+    const ParameterInfo* end() const { return fields + count; }
+
+    // Field with the given name, or null
+    const ParameterInfo* find(const std::string& name) const {
+        for (const ParameterInfo& field : *this) {
+            if (name == field.name) return &field;
+        }
+        return nullptr;
+    }
+
+    // Names of all fields, space separated
+    std::string names() const {
+        std::string out;
+        for (const ParameterInfo& field : *this) out += (out.empty() ? "" : " ") + std::string(field.name);
+        return out;
+    }
+};
+
+// Check a value against its field. Returns false, with the reason in error, if it is out of range.
+inline bool check_parameter(const ParameterInfo& field, double value, std::string& error) {
+    char text[160];
+    if (!(value >= field.low && value <= field.high)) {
+        std::snprintf(text, sizeof(text), "%s = %g is outside [%g, %g]", field.name, value, field.low, field.high);
+        error = text;
+        return false;
+    }
+    if (field.type != RealParameter && value != std::floor(value)) {
+        std::snprintf(text, sizeof(text), "%s = %g must be a whole number", field.name, value);
+        error = text;
+        return false;
+    }
+    return true;
+}
+
+// Store a checked value in its field of out
+inline void store_parameter(const ParameterInfo& field, double value, void* out) {
+    unsigned char* target = static_cast<unsigned char*>(out) + field.offset;
+    if (field.type == RealParameter) {
+        std::memcpy(target, &value, sizeof(double));
+    } else if (field.type == IntegerParameter) {
+        int integer = static_cast<int>(value);
+        std::memcpy(target, &integer, sizeof(int));
+    } else {
+        uint64_t seed = static_cast<uint64_t>(value);
+        std::memcpy(target, &seed, sizeof(uint64_t));
+    }
+}
+
+// Value of a field of in
+inline double read_parameter(const ParameterInfo& field, const void* in) {
+    const unsigned char* source = static_cast<const unsigned char*>(in) + field.offset;
+    if (field.type == RealParameter) {
+        double value;
+        std::memcpy(&value, source, sizeof(double));
+        return value;
+    } else if (field.type == IntegerParameter) {
+        int integer;
+        std::memcpy(&integer, source, sizeof(int));
+        return integer;
+    }
+    uint64_t seed;
+    std::memcpy(&seed, source, sizeof(uint64_t));
+    return static_cast<double>(seed);
+}
+
+// Fill every field of out with its default; seeds get a fresh random value
+template <typename Params>
+void set_defaults(const ParameterSchema& schema, Params& out) {
+    for (const ParameterInfo& field : schema) {
+        if (field.type == SeedParameter) {
+            std::random_device device;
+            uint64_t seed = ((static_cast<uint64_t>(device()) << 32) ^ device()) >> 11;  // Within max_seed
+            std::memcpy(reinterpret_cast<unsigned char*>(&out) + field.offset, &seed, sizeof(seed));
+        } else {
+            store_parameter(field, field.fallback, &out);
+        }
+    }
+}
+
+// Assign one named value to out. Returns false for an unknown name or an invalid value.
+template <typename Params>
+bool assign_parameter(const ParameterSchema& schema, const std::string& name, double value, Params& out, std::string& error) {
+    const ParameterInfo* field = schema.find(name);
+    if (!field) {
+        error = std::string(schema.model) + " has no parameter " + name;
+        return false;
+    }
+    if (!check_parameter(*field, value, error)) return false;
+    store_parameter(*field, value, &out);
+    return true;
+}
+
+// Assign values to out over what it already holds. Returns false, with the reason in error, if
+// a name is unknown or a value is out of range.
+template <typename Params>
+bool assign_parameters(const ParameterSchema& schema, const ParameterSet& values, Params& out, std::string& error) {
+    for (ParameterSet::const_iterator it = values.begin(); it != values.end(); ++it) {
+        if (!assign_parameter(schema, it->first, it->second, out, error)) return false;
+    }
+    return true;
+}
+
+// Check that changes to a forked run leave its StateShape fields alone
+inline bool check_branch_changes(const ParameterSchema& schema, const ParameterSet& changes, std::string& error) {
+    for (ParameterSet::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        const ParameterInfo* field = schema.find(it->first);
+        if (field && (field->flags & StateShape)) {
+            error = it->first + " cannot change when a run of " + schema.model + " forks";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Load out from values over the defaults. Returns false, with the reason in error, if a name
+// is unknown or a value is out of range.
+template <typename Params>
+bool load_parameters(const ParameterSchema& schema, const ParameterSet& values, Params& out, std::string& error) {
+    set_defaults(schema, out);
+    return assign_parameters(schema, values, out, error);
+}
+
+// Load out from a parameter file over the defaults. Returns false, with the reason in error, if
+// the file cannot be read, a line is malformed, a name is unknown or a value is out of range.
+template <typename Params>
+bool load_parameter_file(const ParameterSchema& schema, const std::string& filename, Params& out, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "could not open " + filename;
+        return false;
+    }
+
+    set_defaults(schema, out);
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+        size_t name_end = line.find_first_of("= \t", start);
+        size_t value_start = name_end == std::string::npos ? std::string::npos : line.find_first_not_of("= \t", name_end);
+
+        double value = 0.0;
+        const char* text = value_start == std::string::npos ? "" : line.c_str() + value_start;
+        char* parsed_end = nullptr;
+        if (*text) value = std::strtod(text, &parsed_end);
+        if (!*text || parsed_end == text || std::strspn(parsed_end, " \t\r") != std::strlen(parsed_end)) {
+            error = filename + " line " + std::to_string(line_number) + ": expected name=value";
+            return false;
+        }
+        if (!assign_parameter(schema, line.substr(start, name_end - start), value, out, error)) {
+            error = filename + " line " + std::to_string(line_number) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+const double unbounded = HUGE_VAL;
+const double max_seed = 9007199254740992.0;  // 2^53: seeds pass through doubles exactly up to here
+const double max_steps = 1e7;  // Runs keep every logged row in memory, so total_steps stays within what a run can hold
+
+// SEIR model (SEIR.cpp)
+struct SeirParameters {
+    double beta, sigma, gamma;
+    double reduced_beta, quarantine_time;
+    double vaccination_rate, vaccination_start, vaccination_speed;
+    double initial_susceptible, initial_exposed, initial_infectious, initial_recovered;
+    double dt;
+    int total_steps;
+    int integrator;  // IntegratorKind
+    double step;     // Fixed (or initial adaptive) step; 0 uses dt
+};
+
+inline const ParameterInfo seir_fields[] = {
+    {"beta", RealParameter, offsetof(SeirParameters, beta), 0.6, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"sigma", RealParameter, offsetof(SeirParameters, sigma), 0.1, 0, unbounded, ResultParameter, "Rate at which exposed individuals become infectious"},
+    {"gamma", RealParameter, offsetof(SeirParameters, gamma), 0.2, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"reduced_beta", RealParameter, offsetof(SeirParameters, reduced_beta), 0.35, 0, unbounded, ResultParameter, "Transmission rate during quarantine"},
+    {"quarantine_time", RealParameter, offsetof(SeirParameters, quarantine_time), 20, 0, unbounded, ResultParameter, "Day quarantine starts"},
+    {"vaccination_rate", RealParameter, offsetof(SeirParameters, vaccination_rate), 0.0, 0, unbounded, ResultParameter, "Vaccination rate before the rollout"},
+    {"vaccination_start", RealParameter, offsetof(SeirParameters, vaccination_start), 30, 0, unbounded, ResultParameter, "Day the vaccination rollout starts"},
+    {"vaccination_speed", RealParameter, offsetof(SeirParameters, vaccination_speed), 0.002, 0, unbounded, ResultParameter, "Vaccination rate during the rollout"},
+    {"initial_susceptible", RealParameter, offsetof(SeirParameters, initial_susceptible), 0.94, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_exposed", RealParameter, offsetof(SeirParameters, initial_exposed), 0.01, 0, 1, ResultParameter, "Initial exposed share"},
+    {"initial_infectious", RealParameter, offsetof(SeirParameters, initial_infectious), 0.05, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(SeirParameters, initial_recovered), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"dt", RealParameter, offsetof(SeirParameters, dt), 0.01, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(SeirParameters, total_steps), 20000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(SeirParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(SeirParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema seir_schema = {"SEIR", seir_fields, sizeof(seir_fields) / sizeof(seir_fields[0])};
+
+// SIR model (SIR.cpp)
+struct SirParameters {
+    double beta, gamma;
+    double reduced_beta, quarantine_time;
+    double vaccination_rate, vaccination_start, vaccination_speed;
+    double initial_susceptible, initial_infectious, initial_recovered;
+    double dt;
+    int total_steps;
+    int integrator;  // IntegratorKind
+    double step;     // Fixed (or initial adaptive) step; 0 uses dt
+};
+
+inline const ParameterInfo sir_fields[] = {
+    {"beta", RealParameter, offsetof(SirParameters, beta), 0.4, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"gamma", RealParameter, offsetof(SirParameters, gamma), 0.1, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"reduced_beta", RealParameter, offsetof(SirParameters, reduced_beta), 0.25, 0, unbounded, ResultParameter, "Transmission rate during quarantine"},
+    {"quarantine_time", RealParameter, offsetof(SirParameters, quarantine_time), 0.0, 0, unbounded, ResultParameter, "Day quarantine starts"},
+    {"vaccination_rate", RealParameter, offsetof(SirParameters, vaccination_rate), 0.0, 0, unbounded, ResultParameter, "Vaccination rate before the rollout"},
+    {"vaccination_start", RealParameter, offsetof(SirParameters, vaccination_start), 0.0, 0, unbounded, ResultParameter, "Day the vaccination rollout starts"},
+    {"vaccination_speed", RealParameter, offsetof(SirParameters, vaccination_speed), 0.0, 0, unbounded, ResultParameter, "Vaccination rate during the rollout"},
+    {"initial_susceptible", RealParameter, offsetof(SirParameters, initial_susceptible), 0.99, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_infectious", RealParameter, offsetof(SirParameters, initial_infectious), 0.01, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(SirParameters, initial_recovered), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"dt", RealParameter, offsetof(SirParameters, dt), 0.01, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(SirParameters, total_steps), 20000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(SirParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(SirParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema sir_schema = {"SIR", sir_fields, sizeof(sir_fields) / sizeof(sir_fields[0])};
+
+// SIS model (SIS.cpp)
+struct SisParameters {
+    double beta, gamma;
+    double avoid_contact_factor, health_checkup_factor, vaccination_factor, safe_practices_factor;
+    double initial_susceptible, initial_infectious;
+    double dt;
+    int total_steps;
+    int integrator;  // IntegratorKind
+    double step;     // Fixed (or initial adaptive) step; 0 uses dt
+};
+
+inline const ParameterInfo sis_fields[] = {
+    {"beta", RealParameter, offsetof(SisParameters, beta), 0.3, 0, unbounded, ResultParameter, "Infection rate"},
+    {"gamma", RealParameter, offsetof(SisParameters, gamma), 0.1, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"avoid_contact_factor", RealParameter, offsetof(SisParameters, avoid_contact_factor), 0.0, 0, 1, ResultParameter, "Reduction of beta from avoided contacts"},
+    {"health_checkup_factor", RealParameter, offsetof(SisParameters, health_checkup_factor), 0.0, 0, unbounded, ResultParameter, "Increase of gamma from health check-ups"},
+    {"vaccination_factor", RealParameter, offsetof(SisParameters, vaccination_factor), 0.0, 0, 1, ResultParameter, "Share of susceptibles vaccinated per 0.1 time units"},
+    {"safe_practices_factor", RealParameter, offsetof(SisParameters, safe_practices_factor), 0.0, 0, 1, ResultParameter, "Reduction of beta from safe practices"},
+    {"initial_susceptible", RealParameter, offsetof(SisParameters, initial_susceptible), 0.99, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_infectious", RealParameter, offsetof(SisParameters, initial_infectious), 0.01, 0, 1, ResultParameter, "Initial infectious share"},
+    {"dt", RealParameter, offsetof(SisParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(SisParameters, total_steps), 100, 1, max_steps, ResultParameter, "Logged intervals"},
+    {"integrator", IntegerParameter, offsetof(SisParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(SisParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema sis_schema = {"SIS", sis_fields, sizeof(sis_fields) / sizeof(sis_fields[0])};
+
+// Agent-based model (ABM.cpp)
+struct AbmParameters {
+    int num_agents;
+    int grid_size;
+    double infection_prob;
+    double recovery_prob;
+    double vaccination_prob;
+    double quarantine_prob;
+    double breakthrough_prob;  // Chance per step that a vaccinated agent is infected
+    int infection_radius;
+    int quarantine_duration;   // Steps an agent stays in quarantine
+    int total_steps;
+    uint64_t seed;             // Key of every random draw; equal seeds give identical runs
+    int num_threads;           // 0 uses every hardware thread
+};
+
+inline const ParameterInfo abm_fields[] = {
+    {"num_agents", IntegerParameter, offsetof(AbmParameters, num_agents), 100, 1, 1e8, StateShape, "Number of agents (about 11 bytes each)"},
+    {"grid_size", IntegerParameter, offsetof(AbmParameters, grid_size), 20, 1, 1e6, StateShape, "Side of the square grid"},
+    {"infection_prob", RealParameter, offsetof(AbmParameters, infection_prob), 0.15, 0, 1, ResultParameter, "Infection chance per contact"},
+    {"recovery_prob", RealParameter, offsetof(AbmParameters, recovery_prob), 0.03, 0, 1, ResultParameter, "Recovery chance per step"},
+    {"vaccination_prob", RealParameter, offsetof(AbmParameters, vaccination_prob), 0.02, 0, 1, ResultParameter, "Share of agents vaccinated at the start"},
+    {"quarantine_prob", RealParameter, offsetof(AbmParameters, quarantine_prob), 0.01, 0, 1, ResultParameter, "Chance per step that an infected agent is quarantined"},
+    {"breakthrough_prob", RealParameter, offsetof(AbmParameters, breakthrough_prob), 0.05, 0, 1, ResultParameter, "Chance per step of a breakthrough infection"},
+    {"infection_radius", IntegerParameter, offsetof(AbmParameters, infection_radius), 2, 0, 1e6, ResultParameter, "Contact distance in grid units"},
+    {"quarantine_duration", IntegerParameter, offsetof(AbmParameters, quarantine_duration), 5, 0, 65535, ResultParameter, "Steps an agent stays in quarantine"},
+    {"total_steps", IntegerParameter, offsetof(AbmParameters, total_steps), 100, 1, max_steps, ResultParameter, "Steps to simulate"},
+    {"seed", SeedParameter, offsetof(AbmParameters, seed), 0, 0, max_seed, ResultParameter, "Random seed; random when not given"},
+    {"num_threads", IntegerParameter, offsetof(AbmParameters, num_threads), 0, 0, 4096, RunSetting, "Threads; 0 uses every hardware thread"},
+};
+inline const ParameterSchema abm_schema = {"ABM", abm_fields, sizeof(abm_fields) / sizeof(abm_fields[0])};
+
+// Branching process (BRANCHING.cpp)
+struct BranchingParameters {
+    double reproduction_rate;
+    int initial_infected;
+    int max_generations;
+    double vaccination_prob, quarantine_prob, safe_practices_prob;
+    uint64_t seed;
+};
+
+inline const ParameterInfo branching_fields[] = {
+    {"reproduction_rate", RealParameter, offsetof(BranchingParameters, reproduction_rate), 2.0, 0, 1e6, ResultParameter, "Mean offspring without measures"},
+    {"initial_infected", IntegerParameter, offsetof(BranchingParameters, initial_infected), 5, 0, 1e9, ResultParameter, "Infected individuals in generation 0"},
+    {"max_generations", IntegerParameter, offsetof(BranchingParameters, max_generations), 20, 1, 1e6, ResultParameter, "Generations to simulate"},
+    {"vaccination_prob", RealParameter, offsetof(BranchingParameters, vaccination_prob), 0.0, 0, 1, ResultParameter, "Chance an individual is vaccinated"},
+    {"quarantine_prob", RealParameter, offsetof(BranchingParameters, quarantine_prob), 0.0, 0, 1, ResultParameter, "Chance an individual is quarantined"},
+    {"safe_practices_prob", RealParameter, offsetof(BranchingParameters, safe_practices_prob), 0.0, 0, 1, ResultParameter, "Chance an individual follows safe practices"},
+    {"seed", SeedParameter, offsetof(BranchingParameters, seed), 0, 0, max_seed, ResultParameter, "Random seed; random when not given"},
+};
+inline const ParameterSchema branching_schema = {"Branching", branching_fields, sizeof(branching_fields) / sizeof(branching_fields[0])};
+
+// Markov-chain SIR model (MARKOV_PROCESS_SIR.cpp)
+struct MarkovParameters {
+    int population_size;
+    double p_si, p_ir;
+    int total_steps;
+    double vaccination_rate, protective_measures_rate;
+    uint64_t seed;
+    int engine;  // markov::Engine
+};
+
+inline const ParameterInfo markov_fields[] = {
+    {"population_size", IntegerParameter, offsetof(MarkovParameters, population_size), 100, 1, 2e9, StateShape, "Number of individuals"},
+    {"p_si", RealParameter, offsetof(MarkovParameters, p_si), 0.05, 0, 1, ResultParameter, "Infection chance per step"},
+    {"p_ir", RealParameter, offsetof(MarkovParameters, p_ir), 0.01, 0, 1, ResultParameter, "Recovery chance per step"},
+    {"total_steps", IntegerParameter, offsetof(MarkovParameters, total_steps), 100, 1, max_steps, ResultParameter, "Steps to simulate"},
+    {"vaccination_rate", RealParameter, offsetof(MarkovParameters, vaccination_rate), 0.0, 0, 1, ResultParameter, "Share vaccinated at the start"},
+    {"protective_measures_rate", RealParameter, offsetof(MarkovParameters, protective_measures_rate), 0.0, 0, 1, ResultParameter, "Share using protective measures each step"},
+    {"seed", SeedParameter, offsetof(MarkovParameters, seed), 0, 0, max_seed, ResultParameter, "Random seed; random when not given"},
+    {"engine", IntegerParameter, offsetof(MarkovParameters, engine), 0, 0, 4, StateShape, "0 individual, 1 binomial, 2 SSA, 3 next reaction, 4 tau-leap"},
+};
+inline const ParameterSchema markov_schema = {"MARKONIKOV", markov_fields, sizeof(markov_fields) / sizeof(markov_fields[0])};
+
+// Compartment models run by COMPARTMENTAL.cpp. They share one struct: rates[] holds the model's
+// rates in its Parameter order and initial[] its starting shares in Compartment order, so each
+// schema lists only the entries its model uses. The files are COMPARTMENTAL_<NAME>_params.txt,
+// apart from those of the SIR, SEIR and SIS programs, which have fields of their own.
+struct CompartmentParameters {
+    double rates[4];
+    double initial[5];
+    double dt;
+    int total_steps;
+    int integrator;  // IntegratorKind
+    double step;     // Fixed (or initial adaptive) step; 0 uses dt
+};
+
+inline const ParameterInfo sir_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.4, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"vaccination_rate", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.0, 0, unbounded, ResultParameter, "Rate susceptibles are vaccinated straight to R"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.99, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(CompartmentParameters, initial[2]), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema sir_compartment_schema = {"COMPARTMENTAL_SIR", sir_compartment_fields, sizeof(sir_compartment_fields) / sizeof(sir_compartment_fields[0])};
+
+inline const ParameterInfo seir_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.6, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"sigma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Rate at which exposed individuals become infectious"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.2, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"vaccination_rate", RealParameter, offsetof(CompartmentParameters, rates[3]), 0.0, 0, unbounded, ResultParameter, "Rate susceptibles are vaccinated straight to R"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.94, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_exposed", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial exposed share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[2]), 0.05, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(CompartmentParameters, initial[3]), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema seir_compartment_schema = {"COMPARTMENTAL_SEIR", seir_compartment_fields, sizeof(seir_compartment_fields) / sizeof(seir_compartment_fields[0])};
+
+inline const ParameterInfo sis_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.3, 0, unbounded, ResultParameter, "Infection rate"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"vaccination_rate", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.0, 0, unbounded, ResultParameter, "Rate susceptibles are vaccinated out of the population"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.99, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial infectious share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema sis_compartment_schema = {"COMPARTMENTAL_SIS", sis_compartment_fields, sizeof(sis_compartment_fields) / sizeof(sis_compartment_fields[0])};
+
+inline const ParameterInfo seirs_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.6, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"sigma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Rate at which exposed individuals become infectious"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.2, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"waning_rate", RealParameter, offsetof(CompartmentParameters, rates[3]), 0.01, 0, unbounded, ResultParameter, "Rate recovered people become susceptible again"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.94, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_exposed", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial exposed share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[2]), 0.05, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(CompartmentParameters, initial[3]), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema seirs_compartment_schema = {"COMPARTMENTAL_SEIRS", seirs_compartment_fields, sizeof(seirs_compartment_fields) / sizeof(seirs_compartment_fields[0])};
+
+inline const ParameterInfo seird_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.6, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"sigma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Rate at which exposed individuals become infectious"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.2, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"mortality_rate", RealParameter, offsetof(CompartmentParameters, rates[3]), 0.005, 0, unbounded, ResultParameter, "Death rate of infectious people"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.94, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_exposed", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial exposed share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[2]), 0.05, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(CompartmentParameters, initial[3]), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"initial_dead", RealParameter, offsetof(CompartmentParameters, initial[4]), 0.0, 0, 1, ResultParameter, "Initial dead share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema seird_compartment_schema = {"COMPARTMENTAL_SEIRD", seird_compartment_fields, sizeof(seird_compartment_fields) / sizeof(seird_compartment_fields[0])};
+
+inline const ParameterInfo sirv_compartment_fields[] = {
+    {"beta", RealParameter, offsetof(CompartmentParameters, rates[0]), 0.4, 0, unbounded, ResultParameter, "Transmission rate"},
+    {"gamma", RealParameter, offsetof(CompartmentParameters, rates[1]), 0.1, 0, unbounded, ResultParameter, "Recovery rate"},
+    {"vaccination_rate", RealParameter, offsetof(CompartmentParameters, rates[2]), 0.01, 0, unbounded, ResultParameter, "Rate susceptibles are vaccinated"},
+    {"waning_rate", RealParameter, offsetof(CompartmentParameters, rates[3]), 0.005, 0, unbounded, ResultParameter, "Rate vaccinated people become susceptible again"},
+    {"initial_susceptible", RealParameter, offsetof(CompartmentParameters, initial[0]), 0.99, 0, 1, ResultParameter, "Initial susceptible share"},
+    {"initial_infectious", RealParameter, offsetof(CompartmentParameters, initial[1]), 0.01, 0, 1, ResultParameter, "Initial infectious share"},
+    {"initial_recovered", RealParameter, offsetof(CompartmentParameters, initial[2]), 0.0, 0, 1, ResultParameter, "Initial recovered share"},
+    {"initial_vaccinated", RealParameter, offsetof(CompartmentParameters, initial[3]), 0.0, 0, 1, ResultParameter, "Initial vaccinated share"},
+    {"dt", RealParameter, offsetof(CompartmentParameters, dt), 0.1, 1e-9, unbounded, ResultParameter, "Spacing of the logged time grid"},
+    {"total_steps", IntegerParameter, offsetof(CompartmentParameters, total_steps), 2000, 1, max_steps, ResultParameter, "Logged intervals (200 days at the default dt)"},
+    {"integrator", IntegerParameter, offsetof(CompartmentParameters, integrator), 2, 0, 2, ResultParameter, "0 Euler, 1 RK4, 2 Dormand-Prince"},
+    {"step", RealParameter, offsetof(CompartmentParameters, step), 0.0, 0, unbounded, ResultParameter, "Integrator step; 0 uses dt"},
+};
+inline const ParameterSchema sirv_compartment_schema = {"COMPARTMENTAL_SIRV", sirv_compartment_fields, sizeof(sirv_compartment_fields) / sizeof(sirv_compartment_fields[0])};
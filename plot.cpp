@@ -1,99 +1,81 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include "result_loader.h"
 #include "matplotlib-cpp/matplotlibcpp.h"
 
 namespace plt = matplotlibcpp;
 
-int main() {
-    // Load the CSV file
-    std::string filename = "seir_simulation_results.csv";  // Replace with your filename
-    std::ifstream file(filename);
-    std::string line;
-
-    // Vectors to store data from the CSV
-    std::vector<std::string> headers;
-    std::vector<std::vector<double>> data;
-
-    // Read the first line for headers
-    if (getline(file, line)) {
-        std::stringstream ss(line);
-        std::string header;
-        // Adjust the delimiter based on your file format (use ',' for CSV with commas, '\t' for tab-separated)
-        while (getline(ss, header, ',')) {  // Assuming comma as the delimiter
-            headers.push_back(header);
-        }
+int main(int argc, char* argv[]) {
+    // Usage: plot [results file] [--debug]; the file may be CSV or columnar (.col)
+    std::string filename = "seir_simulation_results.csv";
+    bool debug = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--debug") debug = true;
+        else filename = arg;
     }
 
-    // Debug output to verify headers
-    std::cout << "Headers:\n";
-    for (const auto& header : headers) {
-        std::cout << header << "\n";
+    // Load the results straight into one vector per column
+    ResultTable table;
+    if (!load_results(filename, table) || table.headers.empty()) {
+        std::cerr << "Error: could not read " << filename << std::endl;
+        return -1;
     }
+    const std::vector<std::string>& headers = table.headers;
 
-    // Read the remaining lines for data
-    while (getline(file, line)) {
-        std::stringstream ss(line);
-        std::string value;
-        std::vector<double> row_data;
-        // Split the row by commas (or use '\t' for tab-separated)
-        while (getline(ss, value, ',')) {  // Use ',' for CSV, or '\t' for tab-separated
-            row_data.push_back(std::stod(value));
+    // Debug output to verify headers and data
+    if (debug) {
+        std::cout << "Headers:\n";
+        for (const auto& header : headers) {
+            std::cout << header << "\n";
         }
-        data.push_back(row_data);
-    }
-    file.close();
 
-    // Debug output to verify data is being read correctly
-    std::cout << "\nData:\n";
-    for (const auto& row : data) {
-        for (const auto& val : row) {
-            std::cout << val << " ";
+        std::cout << "\nData:\n";
+        for (size_t i = 0; i < table.rows(); ++i) {
+            for (size_t j = 0; j < table.columns.size(); ++j) {
+                std::cout << table.columns[j][i] << " ";
+            }
+            std::cout << "\n";
         }
-        std::cout << "\n";
     }
 
     // Assuming the first column is time and the rest are dynamic columns (e.g., Susceptible, Infected, Recovered, etc.)
-    std::vector<double> x_data;  // Time steps
-    std::vector<std::vector<double>> y_data(headers.size() - 1);  // Other columns (Susceptible, Infected, etc.)
-
-    // Populate x_data and y_data
-    for (size_t i = 0; i < data.size(); ++i) {
-        x_data.push_back(data[i][0]);  // Time column
-        for (size_t j = 1; j < headers.size(); ++j) {
-            y_data[j - 1].push_back(data[i][j]);  // Other columns
-        }
-    }
+    // The y columns are read in place from the table rather than copied
+    const std::vector<double>& x_data = table.columns[0];  // Time steps
 
     // Debugging output: print a few values from x_data and y_data to verify the sizes and content
-    std::cout << "\nFirst few values of x_data (Time):\n";
-    for (size_t i = 0; i < std::min(x_data.size(), size_t(5)); ++i) {
-        std::cout << "x_data[" << i << "] = " << x_data[i] << "\n";
-    }
+    if (debug) {
+        std::cout << "\nFirst few values of x_data (Time):\n";
+        for (size_t i = 0; i < std::min(x_data.size(), size_t(5)); ++i) {
+            std::cout << "x_data[" << i << "] = " << x_data[i] << "\n";
+        }
 
-    std::cout << "\nFirst few values of y_data:\n";
-    for (size_t i = 0; i < std::min(y_data.size(), size_t(4)); ++i) {
-        std::cout << headers[i + 1] << " data: ";
-        for (size_t j = 0; j < std::min(y_data[i].size(), size_t(5)); ++j) {
-            std::cout << y_data[i][j] << " ";
+        std::cout << "\nFirst few values of y_data:\n";
+        for (size_t c = 1; c < std::min(table.columns.size(), size_t(5)); ++c) {
+            std::cout << headers[c] << " data: ";
+            for (size_t j = 0; j < std::min(table.columns[c].size(), size_t(5)); ++j) {
+                std::cout << table.columns[c][j] << " ";
+            }
+            std::cout << "\n";
         }
-        std::cout << "\n";
     }
 
     // Plot each y-variable (Susceptible, Infected, Recovered, etc.) against time (x-axis)
     plt::figure_size(800, 600);  // Set figure size for better visualization
-    for (size_t i = 0; i < y_data.size(); ++i) {
+    for (size_t c = 1; c < table.columns.size(); ++c) {
+        const std::vector<double>& y_data = table.columns[c];
+
         // Ensure the sizes match before plotting
-        if (x_data.size() != y_data[i].size()) {
+        if (x_data.size() != y_data.size()) {
             std::cerr << "Error: x and y vectors must have the same size!" << std::endl;
-            std::cout << "x_data size: " << x_data.size() << ", y_data[" << i << "] size: " << y_data[i].size() << std::endl;
+            std::cout << "x_data size: " << x_data.size() << ", column " << c << " size: " << y_data.size() << std::endl;
             return -1;
         }
 
         // Plot each y-variable and set the label for the legend
-        plt::plot(x_data, y_data[i], {{"label", headers[i + 1]}});  // Dynamic labeling based on headers
+        plt::plot(x_data, y_data, {{"label", headers[c]}});  // Dynamic labeling based on headers
     }
 
     // Adding title and labels
@@ -109,4 +91,4 @@ int main() {
     plt::show();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+// Counter-based random numbers shared by the stochastic models.
+//
+// Every stream is identified by (seed, id, step, purpose) and its n-th output is a pure
+// function of that key and n (Philox4x32-10, Salmon et al. 2011). Streams hold no shared
+// state, so threads can draw in any order, a run is reproducible from its seed, a stream can
+// skip ahead in O(1), and a single agent's history can be replayed without rerunning the
+// rest of the population.
+
+// Philox4x32-10 block function: maps a 128-bit counter and 64-bit key to 128 random bits
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key) {
+    const uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+    const uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+    for (int round = 0; round < 10; ++round) {
+        uint64_t p0 = static_cast<uint64_t>(M0) * ctr[0];
+        uint64_t p1 = static_cast<uint64_t>(M1) * ctr[2];
+        std::array<uint32_t, 4> next = {{
+            static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+            static_cast<uint32_t>(p1),
+            static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+            static_cast<uint32_t>(p0)
+        }};
+        ctr = next;
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return ctr;
+}
+
+// SplitMix64 finalizer, used to fold the purpose into the Philox key
+inline uint64_t mix64(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Convert 64 random bits to a double in [0, 1) with 53 bits of precision
+inline double bits_to_unit(uint64_t bits) {
+    return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// One keyed random stream. Satisfies UniformRandomBitGenerator, so it can drive the
+// standard <random> distributions directly.
+//
+// Counter layout: word 0 numbers the 4-output blocks of the stream, word 1 holds the step
+// and words 2-3 hold the id. The key is the seed mixed with the purpose. Steps must fit in
+// 32 bits and a stream yields up to 2^34 outputs.
+class RandomStream {
+public:
+    typedef uint32_t result_type;
+
+    RandomStream(uint64_t seed, uint64_t id, uint64_t step, uint32_t purpose)
+        : position(0) {
+        uint64_t k = mix64(seed ^ mix64(purpose));
+        key[0] = static_cast<uint32_t>(k);
+        key[1] = static_cast<uint32_t>(k >> 32);
+        counter[0] = 0;
+        counter[1] = static_cast<uint32_t>(step);
+        counter[2] = static_cast<uint32_t>(id);
+        counter[3] = static_cast<uint32_t>(id >> 32);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    // Next 32 random bits
+    result_type operator()() {
+        uint32_t lane = static_cast<uint32_t>(position & 3);
+        if (lane == 0) refill();
+        ++position;
+        return block[lane];
+    }
+
+    // Uniform double in [0, 1)
+    double uniform() {
+        uint64_t hi = (*this)();
+        uint64_t lo = (*this)();
+        return bits_to_unit((hi << 32) | lo);
+    }
+
+    // Skip the next n outputs without generating them
+    void discard(uint64_t n) {
+        uint64_t target = position + n;
+        bool same_block = (position & 3) != 0 && (target >> 2) == (position >> 2);
+        position = target;
+        if (!same_block && (position & 3) != 0) refill();
+    }
+
+    // Number of outputs drawn so far; saving it with the key is enough to resume the stream
+    uint64_t offset() const { return position; }
+
+private:
+    std::array<uint32_t, 4> counter;
+    std::array<uint32_t, 2> key;
+    std::array<uint32_t, 4> block;
+    uint64_t position;
+
+    void refill() {
+        counter[0] = static_cast<uint32_t>(position >> 2);
+        block = philox4x32(counter, key);
+    }
+};
+
+// Single uniform draw in [0, 1) for (seed, id, step, purpose); equal to the first
+// uniform() of the matching RandomStream
+inline double keyed_uniform(uint64_t seed, uint64_t id, uint64_t step, uint32_t purpose) {
+    return RandomStream(seed, id, step, purpose).uniform();
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "random_streams.h"
+#include "result_loader.h"
+#include "result_sink.h"
+#include "simulation_engine.h"
+
+// On-disk cache of finished runs, addressed by what determines their results.
+//
+// The key of a run is the model name, the engine version and the value of every result
+// parameter of the model's schema (everything but run settings such as the thread count), in
+// schema order with each value written exactly (%.17g). Parameters the run does not set are
+// keyed by their default, so a run that spells out a default shares its entry with one that
+// does not. The seed of a stochastic model is one of those parameters; a stochastic run
+// without a seed is not reproducible and is never cached.
+// An entry is two files named by a 128-bit hash of the key: <hash>.key holds the key itself, so
+// a hash collision is a miss rather than a wrong answer, and <hash>.col holds the results in
+// the columnar format, which loads with one mapping.
+//
+// The cache is bounded in bytes. Hits move an entry to the front of an LRU list and touch its
+// file, so the order survives restarts; storing past the bound evicts from the back. Entries
+// are written to a temporary file and renamed into place, so a reader in another thread or
+// process never sees a partial file. All members may be called from several threads.
+
+class ResultCache {
+public:
+    explicit ResultCache(const std::string& directory = ".epidemic_cache", uint64_t max_bytes = 1ull << 30)
+        : directory(directory), max_bytes(max_bytes), total_bytes(0), temp_counter(0) {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        scan();
+    }
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Key of a run, or an empty string if the run cannot be cached
+    static std::string key(const std::string& model_name, const ParameterSet& params) {
+        const ModelEntry* model = find_model(model_name);
+        if (!model) return std::string();
+
+        std::string text = std::string("model=") + model->name + "\nengine=" + engine_version + "\n";
+        char value[32];
+        for (const ParameterInfo& field : *model->schema) {
+            if (field.flags & RunSetting) continue;
+            ParameterSet::const_iterator it = params.find(field.name);
+            if (it == params.end() && field.type == SeedParameter) return std::string();
+            double v = it == params.end() ? field.fallback : it->second;
+            std::snprintf(value, sizeof(value), "%.17g", v == 0.0 ? 0.0 : v);
+            text += std::string(field.name) + "=" + value + "\n";
+        }
+        return text;
+    }
+
+    // Load the cached results of a run. Returns false on a miss.
+    bool load(const std::string& model_name, const ParameterSet& params, ResultTable& results) {
+        std::string text = key(model_name, params);
+        if (text.empty()) return false;
+        std::string name = hash_name(text);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!entries.count(name)) return false;
+        }
+
+        std::ifstream key_file(path(name, ".key"), std::ios::binary);
+        std::string stored((std::istreambuf_iterator<char>(key_file)), std::istreambuf_iterator<char>());
+        if (stored != text || !load_columnar_results(path(name, ".col"), results)) {
+            // Changed under us, most likely evicted by another process
+            std::lock_guard<std::mutex> lock(mutex);
+            forget(name);
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::last_write_time(path(name, ".col"), std::filesystem::file_time_type::clock::now(), ec);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(name);
+        if (it != entries.end()) recency.splice(recency.begin(), recency, it->second.position);
+        return true;
+    }
+
+    // Store the results of a finished run, evicting the least recently used entries to stay
+    // within the size bound. Runs that cannot be cached are ignored.
+    void store(const std::string& model_name, const ParameterSet& params, const ResultTable& results) {
+        std::string text = key(model_name, params);
+        if (text.empty()) return;
+        std::string name = hash_name(text);
+        std::string temp = path(name, ".tmp" + std::to_string(getpid()) + "." + std::to_string(temp_counter.fetch_add(1)));
+
+        {
+            std::ofstream key_file(temp, std::ios::binary);
+            key_file << text;
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, path(name, ".key"), ec);
+        {
+            ColumnarResultSink sink(temp);
+            for (size_t c = 0; c < results.headers.size(); ++c) sink.field(results.headers[c]);
+            sink.end_row();
+            for (size_t r = 0; r < results.rows(); ++r) {
+                for (size_t c = 0; c < results.columns.size(); ++c) sink.field(results.columns[c][r]);
+                sink.end_row();
+            }
+        }
+        uint64_t bytes = std::filesystem::file_size(temp, ec);
+        if (ec) return;
+        std::filesystem::rename(temp, path(name, ".col"), ec);
+        if (ec) return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        forget(name);
+        recency.push_front(name);
+        Entry entry = {bytes, recency.begin()};
+        entries[name] = entry;
+        total_bytes += bytes;
+        while (total_bytes > max_bytes && recency.size() > 1) evict(recency.back());
+    }
+
+    // Bytes of results held, as far as this process knows
+    uint64_t size_bytes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total_bytes;
+    }
+
+private:
+    struct Entry {
+        uint64_t bytes;
+        std::list<std::string>::iterator position;
+    };
+
+    std::string directory;
+    uint64_t max_bytes;
+    uint64_t total_bytes;
+    std::atomic<uint64_t> temp_counter;
+    std::mutex mutex;
+    std::list<std::string> recency;  // Entry names, most recently used first
+    std::unordered_map<std::string, Entry> entries;
+
+    std::string path(const std::string& name, const std::string& extension) const {
+        return directory + "/" + name + extension;
+    }
+
+    // FNV-1a over the key with two bases, each finished with mix64
+    static std::string hash_name(const std::string& text) {
+        uint64_t h[2] = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+        for (int k = 0; k < 2; ++k) {
+            for (size_t i = 0; i < text.size(); ++i) {
+                h[k] ^= static_cast<unsigned char>(text[i]);
+                h[k] *= 0x100000001b3ULL;
+            }
+            h[k] = mix64(h[k]);
+        }
+        char name[33];
+        std::snprintf(name, sizeof(name), "%016llx%016llx", static_cast<unsigned long long>(h[0]),
+                      static_cast<unsigned long long>(h[1]));
+        return name;
+    }
+
+    // Build the LRU list from the entries on disk, oldest access last
+    void scan() {
+        std::vector<std::pair<std::filesystem::file_time_type, std::pair<std::string, uint64_t> > > found;
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+            const std::filesystem::path& file = it->path();
+            if (file.extension() != ".col") continue;
+            std::error_code file_ec;
+            uint64_t bytes = std::filesystem::file_size(file, file_ec);
+            std::filesystem::file_time_type used = std::filesystem::last_write_time(file, file_ec);
+            if (!file_ec) found.push_back(std::make_pair(used, std::make_pair(file.stem().string(), bytes)));
+        }
+        std::sort(found.begin(), found.end());
+        for (size_t i = 0; i < found.size(); ++i) {
+            recency.push_front(found[i].second.first);
+            Entry entry = {found[i].second.second, recency.begin()};
+            entries[found[i].second.first] = entry;
+            total_bytes += found[i].second.second;
+        }
+        while (total_bytes > max_bytes && !recency.empty()) evict(recency.back());
+    }
+
+    // Drop an entry from the index; caller holds the mutex
+    void forget(const std::string& name) {
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(name);
+        if (it == entries.end()) return;
+        total_bytes -= it->second.bytes;
+        recency.erase(it->second.position);
+        entries.erase(it);
+    }
+
+    // Drop an entry and delete its files; caller holds the mutex
+    void evict(std::string name) {
+        forget(name);
+        std::error_code ec;
+        std::filesystem::remove(path(name, ".col"), ec);
+        std::filesystem::remove(path(name, ".key"), ec);
+    }
+};
+
+// Run a model through the cache: cached results are returned without running, and a finished
+// run is stored for next time. cached, if given, tells which of the two happened.
+inline bool run_model_cached(ResultCache& cache, const std::string& name, const ParameterSet& params,
+                             ResultTable& results, const RunContext& context = RunContext(), bool* cached = nullptr) {
+    if (cached) *cached = false;
+    if (cache.load(name, params, results)) {
+        if (cached) *cached = true;
+        return true;
+    }
+    bool completed = run_model(name, params, results, context);
+    if (completed) cache.store(name, params, results);
+    return completed;
+}
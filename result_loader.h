@@ -0,0 +1,113 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "columnar_file.h"
+#include "result_sink.h"
+
+// Loading of model results for plotting.
+//
+// CSV files are parsed straight out of a memory mapping with std::from_chars: the rows are
+// counted first so every column vector is allocated once at its final size, and no per-line
+// strings or streams are created. Columnar (.col) files are read through ColumnarFile.
+
+namespace loader_detail {
+
+inline const char* skip_line(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+}
+
+inline size_t count_lines(const char* p, const char* end) {
+    size_t lines = 0;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) return lines + 1;
+        ++lines;
+        p = eol + 1;
+    }
+    return lines;
+}
+
+}  // namespace loader_detail
+
+// Parse a CSV result file whose first line names the columns. Fields that are not numbers and
+// fields missing from short rows load as NaN. Returns false if the file cannot be read.
+inline bool load_csv_results(const std::string& filename, ResultTable& out) {
+    using namespace loader_detail;
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    out.headers.clear();
+    out.columns.clear();
+    if (file.size() == 0) return true;
+
+    const char* p = file.chars();
+    const char* end = p + file.size();
+
+    // Header
+    const char* header_end = skip_line(p, end);
+    const char* name_end = header_end;
+    while (name_end > p && (name_end[-1] == '\n' || name_end[-1] == '\r')) --name_end;
+    for (const char* q = p;; ++q) {
+        if (q == name_end || *q == ',') {
+            out.headers.push_back(std::string(p, q));
+            if (q == name_end) break;
+            p = q + 1;
+        }
+    }
+    p = header_end;
+
+    size_t columns = out.headers.size();
+    size_t capacity = count_lines(p, end);
+    out.columns.assign(columns, std::vector<double>());
+    for (size_t c = 0; c < columns; ++c) out.columns[c].resize(capacity);
+
+    size_t row = 0;
+    while (p < end) {
+        if (*p == '\n' || *p == '\r') {  // Blank line
+            p = skip_line(p, end);
+            continue;
+        }
+        for (size_t c = 0; c < columns; ++c) {
+            double value = NAN;
+            if (p < end && *p != '\n' && *p != '\r') {
+                if (*p == '+') ++p;  // from_chars does not accept a leading plus
+                std::from_chars_result r = std::from_chars(p, end, value);
+                if (r.ec != std::errc()) value = NAN;
+                p = r.ptr;
+                while (p < end && *p != ',' && *p != '\n' && *p != '\r') ++p;  // Skip anything unparsed
+            }
+            out.columns[c][row] = value;
+            if (p < end && *p == ',') ++p;
+        }
+        p = skip_line(p, end);
+        ++row;
+    }
+
+    for (size_t c = 0; c < columns; ++c) out.columns[c].resize(row);
+    return true;
+}
+
+// Load every column of a columnar result file as doubles
+inline bool load_columnar_results(const std::string& filename, ResultTable& out) {
+    ColumnarFile file;
+    if (!file.open(filename)) return false;
+    out.headers.clear();
+    out.columns.clear();
+    for (size_t c = 0; c < file.columns(); ++c) {
+        out.headers.push_back(file.name(c));
+        out.columns.push_back(file.column_as_double(c));
+    }
+    return true;
+}
+
+// Load a result file in either format, chosen by the .col extension
+inline bool load_results(const std::string& filename, ResultTable& out) {
+    bool columnar = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".col") == 0;
+    return columnar ? load_columnar_results(filename, out) : load_csv_results(filename, out);
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "columnar_file.h"
+
+// Result writers shared by the models.
+//
+// A model writes rows of fields to a ResultSink; the first row holds the column names. Two
+// sinks exist: CSV text and the binary columnar format of columnar_file.h. Both buffer in
+// memory and write in large chunks; a third collects the rows in a ResultTable in memory. The format is chosen once per process, normally from the
+// command line with --output-format csv|columnar, and open_result_sink() then opens the right
+// sink for each output. Requires C++17.
+
+// How floating-point fields are formatted in text output. Both match printf: FixedFormat is
+// "%.Nf" and GeneralFormat is "%.Ng", the iostream default at precision 6.
+enum NumberFormat { FixedFormat, GeneralFormat };
+
+// Results held in memory: one vector of values per column
+struct ResultTable {
+    std::vector<std::string> headers;
+    std::vector<std::vector<double> > columns;
+
+    size_t rows() const { return columns.empty() ? 0 : columns[0].size(); }
+};
+
+class ResultSink {
+public:
+    virtual ~ResultSink() {}
+
+    virtual bool is_open() const = 0;
+    virtual void end_row() = 0;
+    virtual void flush() = 0;
+    virtual void close() = 0;
+
+    // Format used by the floating-point fields that follow; ignored by binary sinks
+    virtual void set_format(NumberFormat, int) {}
+
+    void field(double value) { write_real(value); }
+    void field(const std::string& value) { write_text(value); }
+    void field(const char* value) { write_text(value); }
+
+    template <typename Integer>
+    typename std::enable_if<std::is_integral<Integer>::value>::type field(Integer value) {
+        write_integer(static_cast<long long>(value));
+    }
+
+    // Write one complete row
+    template <typename... Fields>
+    void row(const Fields&... fields) {
+        (field(fields), ...);
+        end_row();
+    }
+
+protected:
+    virtual void write_real(double value) = 0;
+    virtual void write_integer(long long value) = 0;
+    virtual void write_text(const std::string& value) = 0;
+};
+
+// CSV text. Rows are formatted straight into the buffer with std::to_chars (no locale or stream
+// state involved), so a run of 20,000 rows costs a handful of writes instead of a flush per row.
+class CsvResultSink : public ResultSink {
+public:
+    explicit CsvResultSink(const std::string& filename, size_t chunk_bytes = 1 << 20)
+        : file(filename, std::ios::binary), buffer(chunk_bytes + field_capacity), used(0),
+          format(GeneralFormat), precision(6), row_started(false) {}
+
+    ~CsvResultSink() { close(); }
+
+    CsvResultSink(const CsvResultSink&) = delete;
+    CsvResultSink& operator=(const CsvResultSink&) = delete;
+
+    bool is_open() const { return file.is_open(); }
+
+    void set_format(NumberFormat number_format, int digits) {
+        format = number_format;
+        precision = digits;
+    }
+
+    void end_row() {
+        reserve(1);
+        buffer[used++] = '\n';
+        row_started = false;
+        if (used >= buffer.size() - field_capacity) flush();
+    }
+
+    void flush() {
+        if (used > 0 && file.is_open()) file.write(buffer.data(), used);
+        used = 0;
+    }
+
+    void close() {
+        flush();
+        if (file.is_open()) file.close();
+    }
+
+protected:
+    void write_real(double value) {
+        separate();
+        std::to_chars_result r = format == FixedFormat
+            ? std::to_chars(cursor(), limit(), value, std::chars_format::fixed, precision)
+            : std::to_chars(cursor(), limit(), value, std::chars_format::general, precision);
+        if (r.ec == std::errc()) {
+            used = r.ptr - buffer.data();
+        } else {
+            append(std::to_string(value));  // Fixed format of a huge value; never hit by the models
+        }
+    }
+
+    void write_integer(long long value) {
+        separate();
+        used = std::to_chars(cursor(), limit(), value).ptr - buffer.data();
+    }
+
+    void write_text(const std::string& value) {
+        separate();
+        append(value);
+    }
+
+private:
+    static const size_t field_capacity = 352;  // Longest to_chars output for a double plus margin
+
+    std::ofstream file;
+    std::vector<char> buffer;
+    size_t used;
+    NumberFormat format;
+    int precision;
+    bool row_started;
+
+    char* cursor() { return buffer.data() + used; }
+    char* limit() { return buffer.data() + buffer.size(); }
+
+    // Make room for n more bytes, flushing the buffer if needed
+    void reserve(size_t n) {
+        if (used + n > buffer.size()) flush();
+        if (n > buffer.size()) buffer.resize(n);
+    }
+
+    void separate() {
+        reserve(field_capacity);
+        if (row_started) buffer[used++] = ',';
+        row_started = true;
+    }
+
+    void append(const std::string& value) {
+        reserve(value.size());
+        value.copy(cursor(), value.size());
+        used += value.size();
+    }
+};
+
+// Binary columnar file (see columnar_file.h). Rows are collected column by column and written
+// as one chunk every chunk_rows rows. Column types come from the first data row: integer
+// fields become int64 columns and floating-point fields float64 columns. Text is only
+// meaningful in the header row; text fields after it, and fields missing from a short row,
+// are stored as NaN (or 0 in integer columns).
+class ColumnarResultSink : public ResultSink {
+public:
+    explicit ColumnarResultSink(const std::string& filename, size_t chunk_rows = 65536)
+        : file(filename, std::ios::binary), chunk_rows(chunk_rows), header_done(false), header_written(false),
+          column(0), rows_in_chunk(0), total_rows(0), offset(0) {}
+
+    ~ColumnarResultSink() { close(); }
+
+    ColumnarResultSink(const ColumnarResultSink&) = delete;
+    ColumnarResultSink& operator=(const ColumnarResultSink&) = delete;
+
+    bool is_open() const { return file.is_open(); }
+
+    void end_row() {
+        if (!header_done) {
+            header_done = true;
+            values.resize(names.size());
+            column = 0;
+            return;
+        }
+        if (!header_written) write_header();
+        for (; column < values.size(); ++column) values[column].push_back(missing(column));
+        column = 0;
+        if (++rows_in_chunk == chunk_rows) write_chunk();
+    }
+
+    // Write the rows collected so far as a chunk
+    void flush() {
+        if (rows_in_chunk > 0) write_chunk();
+        if (file.is_open()) file.flush();
+    }
+
+    void close() {
+        if (!file.is_open()) return;
+        if (!header_written) write_header();
+        if (rows_in_chunk > 0) write_chunk();
+
+        // Chunk index and footer
+        uint64_t index_offset = offset;
+        for (size_t k = 0; k < index.size(); ++k) {
+            put<uint64_t>(index[k].offset);
+            put<uint64_t>(index[k].first_row);
+            put<uint64_t>(index[k].row_count);
+        }
+        put<uint64_t>(index.size());
+        put<uint64_t>(total_rows);
+        put<uint64_t>(index_offset);
+        file.write(columnar::footer_magic, 8);
+        file.close();
+    }
+
+protected:
+    void write_real(double value) {
+        if (!header_done) {
+            add_column(std::to_string(value));
+        } else if (column < values.size()) {
+            if (!header_written) types[column] = Float64Column;
+            values[column].push_back(types[column] == Float64Column ? bits_of(value) : static_cast<uint64_t>(static_cast<int64_t>(value)));
+            ++column;
+        }
+    }
+
+    void write_integer(long long value) {
+        if (!header_done) {
+            add_column(std::to_string(value));
+        } else if (column < values.size()) {
+            if (!header_written) types[column] = Int64Column;
+            values[column].push_back(types[column] == Int64Column ? static_cast<uint64_t>(value) : bits_of(static_cast<double>(value)));
+            ++column;
+        }
+    }
+
+    void write_text(const std::string& value) {
+        if (!header_done) {
+            add_column(value);
+        } else if (column < values.size()) {
+            values[column].push_back(missing(column));
+            ++column;
+        }
+    }
+
+private:
+    struct IndexEntry {
+        uint64_t offset, first_row, row_count;
+    };
+
+    std::ofstream file;
+    size_t chunk_rows;
+    bool header_done;     // The header row has ended; later fields are data
+    bool header_written;  // Column types are fixed and the header is in the file
+    size_t column;        // Next column of the current row
+    size_t rows_in_chunk;
+    uint64_t total_rows;
+    uint64_t offset;      // Bytes written so far
+    std::vector<std::string> names;
+    std::vector<ColumnType> types;
+    std::vector<std::vector<uint64_t> > values;  // Raw 8-byte values of the current chunk
+    std::vector<IndexEntry> index;
+
+    static uint64_t bits_of(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    uint64_t missing(size_t c) const { return types[c] == Float64Column ? bits_of(NAN) : 0; }
+
+    void add_column(const std::string& name) {
+        names.push_back(name);
+        types.push_back(Float64Column);
+    }
+
+    template <typename T>
+    void put(T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        offset += sizeof(T);
+    }
+
+    // Written at the end of the first data row, once that row has fixed the column types
+    void write_header() {
+        header_written = true;
+        size_t size = 16;
+        for (size_t c = 0; c < names.size(); ++c) size += 4 + names[c].size();
+        size = columnar::padded_to_8(size);
+
+        file.write(columnar::header_magic, 8);
+        offset += 8;
+        put<uint32_t>(static_cast<uint32_t>(names.size()));
+        put<uint32_t>(static_cast<uint32_t>(size));
+        for (size_t c = 0; c < names.size(); ++c) {
+            put<uint8_t>(types[c]);
+            put<uint8_t>(0);
+            put<uint16_t>(static_cast<uint16_t>(names[c].size()));
+            file.write(names[c].data(), names[c].size());
+            offset += names[c].size();
+        }
+        while (offset < size) put<uint8_t>(0);
+    }
+
+    void write_chunk() {
+        IndexEntry entry = {offset, total_rows, rows_in_chunk};
+        index.push_back(entry);
+        put<uint64_t>(rows_in_chunk);
+        for (size_t c = 0; c < values.size(); ++c) {
+            file.write(reinterpret_cast<const char*>(values[c].data()), values[c].size() * sizeof(uint64_t));
+            offset += values[c].size() * sizeof(uint64_t);
+            values[c].clear();
+        }
+        total_rows += rows_in_chunk;
+        rows_in_chunk = 0;
+    }
+};
+
+// Rows collected in a ResultTable, for models run inside another program. The header row names
+// the columns and every later field is stored as a double; text and missing fields become NaN.
+class TableResultSink : public ResultSink {
+public:
+    explicit TableResultSink(ResultTable& table) : table(table), header_done(false), column(0) {
+        table.headers.clear();
+        table.columns.clear();
+    }
+
+    bool is_open() const { return true; }
+
+    void end_row() {
+        if (!header_done) {
+            header_done = true;
+            table.columns.assign(table.headers.size(), std::vector<double>());
+        } else {
+            for (; column < table.columns.size(); ++column) table.columns[column].push_back(NAN);
+        }
+        column = 0;
+    }
+
+    void flush() {}
+    void close() {}
+
+protected:
+    void write_real(double value) {
+        if (!header_done) table.headers.push_back(std::to_string(value));
+        else store(value);
+    }
+
+    void write_integer(long long value) {
+        if (!header_done) table.headers.push_back(std::to_string(value));
+        else store(static_cast<double>(value));
+    }
+
+    void write_text(const std::string& value) {
+        if (!header_done) table.headers.push_back(value);
+        else store(NAN);
+    }
+
+private:
+    ResultTable& table;
+    bool header_done;
+    size_t column;  // Next column of the current row
+
+    void store(double value) {
+        if (column < table.columns.size()) table.columns[column++].push_back(value);
+    }
+};
+
+enum ResultFormat { CsvResults, ColumnarResults };
+
+// Output format of this process; CSV unless changed
+inline ResultFormat& result_format() {
+    static ResultFormat format = CsvResults;
+    return format;
+}
+
+// Pick the output format from --output-format csv|columnar on the command line
+inline void select_result_format(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--output-format") {
+            std::string name = argv[i + 1];
+            if (name == "columnar") result_format() = ColumnarResults;
+            else if (name == "csv") result_format() = CsvResults;
+        }
+    }
+}
+
+// Name a result file gets in the current format: "X.csv" becomes "X.col" for columnar output
+inline std::string result_filename(const std::string& csv_filename) {
+    if (result_format() != ColumnarResults) return csv_filename;
+    std::string::size_type dot = csv_filename.rfind(".csv");
+    return (dot == std::string::npos ? csv_filename : csv_filename.substr(0, dot)) + ".col";
+}
+
+// Open the sink for a result file given by its CSV name, in the current format
+inline std::unique_ptr<ResultSink> open_result_sink(const std::string& csv_filename) {
+    if (result_format() == ColumnarResults) {
+        return std::unique_ptr<ResultSink>(new ColumnarResultSink(result_filename(csv_filename)));
+    }
+    return std::unique_ptr<ResultSink>(new CsvResultSink(csv_filename));
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+#include "result_sink.h"
+
+// Rows of a run streamed to another thread while the run is in progress.
+//
+// The running model writes through a StreamingResultSink, which keeps the complete table like
+// TableResultSink and also copies each finished row into a ResultStream. The stream is a
+// single-producer single-consumer ring of rows: the GUI drains it once per frame and only
+// ever touches the rows that arrived since the last frame.
+
+class ResultStream {
+public:
+    explicit ResultStream(size_t capacity_rows = 65536)
+        : capacity(capacity_rows + 1), width(0), started(false), detached(false), head(0), tail(0) {}
+
+    ResultStream(const ResultStream&) = delete;
+    ResultStream& operator=(const ResultStream&) = delete;
+
+    // Producer: publish the column names; rows may follow
+    void start(const std::vector<std::string>& headers) {
+        names = headers;
+        width = headers.size();
+        ring.assign(capacity * width, 0.0);
+        started.store(true, std::memory_order_release);
+    }
+
+    // Producer: append one row of width() values. Waits while the ring is full, unless the
+    // consumer has detached or cancel (when given) is set, in which case the row is dropped.
+    // The cancel flag lets a run stop even if its consumer went away without detaching.
+    void push(const double* row, const std::atomic<bool>* cancel = nullptr) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = t + 1 == capacity ? 0 : t + 1;
+        while (next == head.load(std::memory_order_acquire)) {
+            if (detached.load(std::memory_order_relaxed)) return;
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (size_t c = 0; c < width; ++c) ring[t * width + c] = row[c];
+        tail.store(next, std::memory_order_release);
+    }
+
+    // Consumer: true once the column names are available
+    bool ready() const { return started.load(std::memory_order_acquire); }
+    const std::vector<std::string>& headers() const { return names; }
+    size_t columns() const { return width; }
+
+    // Consumer: append the rows that arrived since the last call to rows (row-major) and
+    // return their number. Only valid once ready().
+    size_t read(std::vector<double>& rows) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (h != t) {
+            rows.insert(rows.end(), ring.begin() + h * width, ring.begin() + (h + 1) * width);
+            h = h + 1 == capacity ? 0 : h + 1;
+            ++count;
+        }
+        head.store(h, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: stop reading; the producer no longer waits for room
+    void detach() { detached.store(true, std::memory_order_relaxed); }
+
+private:
+    size_t capacity;  // Slots in the ring; one stays free to tell full from empty
+    size_t width;
+    std::vector<std::string> names;
+    std::vector<double> ring;
+    std::atomic<bool> started;
+    std::atomic<bool> detached;
+    alignas(64) std::atomic<size_t> head;  // Next row to read; written by the consumer only
+    alignas(64) std::atomic<size_t> tail;  // Next row to write; written by the producer only
+};
+
+// TableResultSink that also streams every completed data row. Rows are dropped rather than
+// waited for once cancel (when given) is set.
+class StreamingResultSink : public TableResultSink {
+public:
+    StreamingResultSink(ResultTable& table, ResultStream& stream, const std::atomic<bool>* cancel = nullptr)
+        : TableResultSink(table), table(table), stream(stream), cancel(cancel), header_sent(false) {}
+
+    void end_row() {
+        TableResultSink::end_row();
+        if (!header_sent) {
+            header_sent = true;
+            stream.start(table.headers);
+            row.resize(table.headers.size());
+            return;
+        }
+        for (size_t c = 0; c < row.size(); ++c) row[c] = table.columns[c].back();
+        stream.push(row.data(), cancel);
+    }
+
+private:
+    ResultTable& table;
+    ResultStream& stream;
+    const std::atomic<bool>* cancel;
+    bool header_sent;
+    std::vector<double> row;
+};
+
+// Send a finished table through a stream, as if it were being produced; stops once cancel (when
+// given) is set
+inline void stream_table(const ResultTable& table, ResultStream& stream, const std::atomic<bool>* cancel = nullptr) {
+    stream.start(table.headers);
+    std::vector<double> row(table.columns.size());
+    for (size_t r = 0; r < table.rows(); ++r) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) return;
+        for (size_t c = 0; c < row.size(); ++c) row[c] = table.columns[c][r];
+        stream.push(row.data(), cancel);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "params.h"
+#include "result_sink.h"
+
+// In-process simulation library.
+//
+// Each model program also builds as a library: compiled with -DEPIDEMIC_LIBRARY its main() is
+// left out, and everything else lives in the model's own namespace. That way all six model
+// files link into one binary next to the GUI:
+//
+//     g++ -std=c++17 -O2 -DEPIDEMIC_LIBRARY -c SEIR.cpp SIR.cpp SIS.cpp ABM.cpp BRANCHING.cpp MARKOV_PROCESS_SIR.cpp
+//     g++ -std=c++17 -O2 main.cpp SEIR.o SIR.o SIS.o ABM.o BRANCHING.o MARKOV_PROCESS_SIR.o <imgui and glfw> -pthread
+//
+// Every model has the same entry point, <model>::run(params, out, context). params holds the
+// name=value pairs of the model's *_params.txt file, loaded through the model's schema (see
+// params.h); names it does not set keep their defaults. The rows the program would write to its
+// results file go to out, and run returns false if a parameter is unknown or out of range, or
+// if the run was cancelled before it finished.
+//
+// The stochastic models with a step-by-step state (the ABM, and MARKONIKOV with its individual
+// or binomial engine) can also fork a run: <model>::fork(params, fork_step, context, error) runs
+// to the end of step fork_step, watched and stopped through context, and keeps the state in
+// memory, and <model>::branch(fork, changes, out, context) continues a copy of it to the end with
+// changes applied over the fork's parameters. A branch writes every row of its
+// run, the shared prefix included, and keeps the fork's random streams unless it changes the
+// seed, so branches differ only through their changes. Parameters flagged StateShape cannot be
+// changed, and changing the vaccination share vaccinates that share of the susceptibles at
+// the fork.
+
+// Version of the models' numerical results. Bump it with any change that alters what a model
+// writes for given parameters, so results cached by older builds are not reused.
+const char engine_version[] = "2";
+
+// Settings of a run that are not model parameters. A run started on a worker thread is watched
+// and stopped through progress and cancel, which another thread may read and set at any time.
+struct RunContext {
+    std::ostream* log;                // Receives the monitoring lines the programs print; null for none
+    std::atomic<float>* progress;     // Set to the fraction of the run done; null if unused
+    const std::atomic<bool>* cancel;  // When set, the run stops early and returns false; null if unused
+
+    RunContext() : log(nullptr), progress(nullptr), cancel(nullptr) {}
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+
+    // Record progress; false once the run should stop
+    bool proceed(double fraction_done) const {
+        if (progress) progress->store(static_cast<float>(fraction_done), std::memory_order_relaxed);
+        return !cancelled();
+    }
+};
+
+// State of a forked run. It is never changed once made, so branches on any number of threads
+// share it; each copies the state when it starts.
+struct ForkPoint {
+    virtual ~ForkPoint() {}
+};
+
+namespace seir { bool run(const ParameterSet& params, ResultSink& out, const RunContext& context); }
+namespace sir { bool run(const ParameterSet& params, ResultSink& out, const RunContext& context); }
+namespace sis { bool run(const ParameterSet& params, ResultSink& out, const RunContext& context); }
+namespace abm {
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context);
+std::shared_ptr<const ForkPoint> fork(const ParameterSet& params, int fork_step, const RunContext& context, std::string& error);
+bool branch(const ForkPoint& fork, const ParameterSet& changes, ResultSink& out, const RunContext& context);
+}
+namespace branching { bool run(const ParameterSet& params, ResultSink& out, const RunContext& context); }
+namespace markov {
+bool run(const ParameterSet& params, ResultSink& out, const RunContext& context);
+std::shared_ptr<const ForkPoint> fork(const ParameterSet& params, int fork_step, const RunContext& context, std::string& error);
+bool branch(const ForkPoint& fork, const ParameterSet& changes, ResultSink& out, const RunContext& context);
+}
+
+// A model of the library, under the name its parameter and results files use
+struct ModelEntry {
+    const char* name;
+    const char* results_file;  // Written by the standalone program
+    const ParameterSchema* schema;  // Parameters run() reads
+    bool (*run)(const ParameterSet& params, ResultSink& out, const RunContext& context);
+    // Null for models that cannot fork
+    std::shared_ptr<const ForkPoint> (*fork)(const ParameterSet& params, int fork_step, const RunContext& context, std::string& error);
+    bool (*branch)(const ForkPoint& fork, const ParameterSet& changes, ResultSink& out, const RunContext& context);
+};
+
+inline const ModelEntry model_catalogue[] = {
+    {"SEIR", "SEIR_simulation_results.csv", &seir_schema, seir::run, nullptr, nullptr},
+    {"SIR", "SIR_simulation_results.csv", &sir_schema, sir::run, nullptr, nullptr},
+    {"SIS", "SIS_simulation_results.csv", &sis_schema, sis::run, nullptr, nullptr},
+    {"ABM", "ABM_simulation_results.csv", &abm_schema, abm::run, abm::fork, abm::branch},
+    {"Branching", "Branching_simulation_results.csv", &branching_schema, branching::run, nullptr, nullptr},
+    {"MARKONIKOV", "MARKONIKOV_simulation_results.csv", &markov_schema, markov::run, markov::fork, markov::branch},
+};
+
+// Catalogue entry of the named model, or null
+inline const ModelEntry* find_model(const std::string& name) {
+    for (const ModelEntry& entry : model_catalogue) {
+        if (name == entry.name) return &entry;
+    }
+    return nullptr;
+}
+
+// True if the model reads the named parameter
+inline bool model_reads(const ModelEntry& model, const std::string& name) {
+    return model.schema->find(name) != nullptr;
+}
+
+// Run the named model, writing its rows to out.
+// Returns false for an unknown model or a run that failed or was cancelled.
+inline bool run_model(const std::string& name, const ParameterSet& params, ResultSink& out,
+                      const RunContext& context = RunContext()) {
+    const ModelEntry* model = find_model(name);
+    return model && model->run(params, out, context);
+}
+
+// Run the named model and collect its results in memory
+inline bool run_model(const std::string& name, const ParameterSet& params, ResultTable& results,
+                      const RunContext& context = RunContext()) {
+    TableResultSink sink(results);
+    return run_model(name, params, sink, context);
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "random_streams.h"
+#include "simulation_engine.h"
+
+// Sweep specifications for the batch runner.
+//
+// A sweep file uses the name=value lines of the *_params.txt files. A few names configure the
+// sweep itself:
+//
+//   model=SEIR          catalogue name of the model to run
+//   design=grid         grid, lhs (Latin hypercube) or sobol
+//   samples=1024        number of points of an lhs or sobol design
+//   seed=1              seeds the lhs design and the per-scenario seeds of stochastic models
+//   fork_at=30          forks every scenario from one run to the end of step 30 (ABM and
+//                       MARKONIKOV only; see below)
+//
+// Every other line names a parameter of the model's schema (see params.h). A single value fixes
+// it for every scenario; low:high sweeps it over that range. A grid takes low:high:levels
+// instead, with the levels spaced evenly including both ends, and runs every combination.
+// Values and range ends are checked against the schema, and swept integer parameters are
+// rounded to the nearest whole number. Lines starting with # are ignored.
+//
+// With fork_at, the fixed values and the sweep's seed configure one baseline run up to the fork,
+// and each scenario is a branch of it that changes only the swept parameters (see
+// simulation_engine.h). Parameters that shape the model's state cannot be swept then.
+
+enum SweepDesign { GridDesign, LatinHypercubeDesign, SobolDesign };
+
+// One swept parameter
+struct SweepDimension {
+    std::string name;
+    double low, high;
+    size_t levels;  // Grid only
+    bool integer;   // Values are rounded to whole numbers
+};
+
+struct SweepSpec {
+    std::string model;
+    SweepDesign design;
+    size_t samples;
+    uint64_t seed;
+    int fork_at;                             // Step the scenarios fork from; 0 runs each from the start
+    ParameterSet fixed;                      // Parameters with the same value in every scenario
+    std::vector<SweepDimension> dimensions;  // Parameters that vary, in file order
+
+    SweepSpec() : design(GridDesign), samples(0), seed(1), fork_at(0) {}
+
+    // Number of scenarios the design produces
+    size_t scenarios() const {
+        if (design != GridDesign) return samples;
+        size_t n = 1;
+        for (size_t d = 0; d < dimensions.size(); ++d) n *= dimensions[d].levels;
+        return n;
+    }
+};
+
+// Random streams of the Latin hypercube
+enum SweepRandomPurpose { StratumShuffleDraw = 100, StratumJitterDraw };
+
+// Sobol' direction numbers for dimensions 2-16 (Joe and Kuo 2008): degree s of the primitive
+// polynomial, its inner coefficients a, and the initial odd integers m_1..m_s. Dimension 1 is
+// the van der Corput sequence.
+struct SobolPolynomial {
+    unsigned s, a;
+    unsigned m[6];
+};
+
+const SobolPolynomial sobol_polynomials[] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+};
+
+const size_t sobol_max_dimensions = 1 + sizeof(sobol_polynomials) / sizeof(sobol_polynomials[0]);
+
+// 32-bit Sobol' points. A coordinate is computed directly from the Gray code of the point
+// index, so points can be generated in any order.
+class SobolSequence {
+public:
+    explicit SobolSequence(size_t dimensions) : directions(dimensions) {
+        for (size_t d = 0; d < dimensions; ++d) {
+            uint32_t* v = directions[d].data();
+            if (d == 0) {
+                for (unsigned k = 0; k < 32; ++k) v[k] = 1u << (31 - k);
+                continue;
+            }
+            const SobolPolynomial& poly = sobol_polynomials[d - 1];
+            for (unsigned k = 0; k < poly.s; ++k) v[k] = poly.m[k] << (31 - k);
+            for (unsigned k = poly.s; k < 32; ++k) {
+                v[k] = v[k - poly.s] ^ (v[k - poly.s] >> poly.s);
+                for (unsigned j = 1; j < poly.s; ++j) {
+                    if ((poly.a >> (poly.s - 1 - j)) & 1) v[k] ^= v[k - j];
+                }
+            }
+        }
+    }
+
+    // Coordinate d of point i, in [0, 1)
+    double coordinate(uint32_t i, size_t d) const {
+        uint32_t gray = i ^ (i >> 1);
+        uint32_t x = 0;
+        for (unsigned k = 0; gray != 0; ++k, gray >>= 1) {
+            if (gray & 1) x ^= directions[d][k];
+        }
+        return x * (1.0 / 4294967296.0);
+    }
+
+private:
+    std::vector<std::array<uint32_t, 32> > directions;
+};
+
+// Parameters of every scenario of the spec: one ParameterSet per scenario holding the fixed
+// parameters and that scenario's value of each swept one. The scenario order, and so every
+// scenario's index, depends only on the spec.
+inline std::vector<ParameterSet> expand_sweep(const SweepSpec& spec) {
+    size_t n = spec.scenarios();
+    size_t dims = spec.dimensions.size();
+    std::vector<ParameterSet> scenarios(n, spec.fixed);
+
+    // Unit-cube coordinates of each scenario, row-major
+    std::vector<double> unit(n * dims);
+    if (spec.design == GridDesign) {
+        // The last dimension varies fastest
+        for (size_t i = 0; i < n; ++i) {
+            size_t rest = i;
+            for (size_t d = dims; d-- > 0;) {
+                size_t levels = spec.dimensions[d].levels;
+                size_t level = rest % levels;
+                rest /= levels;
+                unit[i * dims + d] = levels > 1 ? static_cast<double>(level) / (levels - 1) : 0.0;
+            }
+        }
+    } else if (spec.design == LatinHypercubeDesign) {
+        // One point in each of the n strata of every dimension, at a random spot within it
+        std::vector<size_t> strata(n);
+        for (size_t d = 0; d < dims; ++d) {
+            RandomStream shuffle(spec.seed, d, 0, StratumShuffleDraw);
+            RandomStream jitter(spec.seed, d, 0, StratumJitterDraw);
+            for (size_t i = 0; i < n; ++i) strata[i] = i;
+            for (size_t i = n; i > 1; --i) {
+                size_t j = static_cast<size_t>(shuffle.uniform() * i);
+                std::swap(strata[i - 1], strata[j]);
+            }
+            for (size_t i = 0; i < n; ++i) unit[i * dims + d] = (strata[i] + jitter.uniform()) / n;
+        }
+    } else {
+        // Point 0 is the origin and is skipped
+        SobolSequence sobol(dims);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t d = 0; d < dims; ++d) unit[i * dims + d] = sobol.coordinate(static_cast<uint32_t>(i + 1), d);
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t d = 0; d < dims; ++d) {
+            const SweepDimension& dim = spec.dimensions[d];
+            double value = dim.low + (dim.high - dim.low) * unit[i * dims + d];
+            scenarios[i][dim.name] = dim.integer ? std::round(value) : value;
+        }
+    }
+    return scenarios;
+}
+
+// Split "a:b:c" at the colons
+inline std::vector<std::string> split_range(const std::string& text) {
+    std::vector<std::string> parts;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ':')) parts.push_back(part);
+    return parts;
+}
+
+inline bool parse_number(const std::string& text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+// Read a sweep file. Returns false, with the reason in error, if the file cannot be read or
+// does not describe a sweep of a catalogue model over parameters it reads.
+inline bool read_sweep_spec(const std::string& filename, SweepSpec& spec, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "could not open " + filename;
+        return false;
+    }
+
+    spec = SweepSpec();
+    std::string line;
+    std::vector<std::pair<std::string, std::string> > ranges;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+        std::string::size_type eq = line.find('=');
+        if (eq == std::string::npos) {
+            error = "line " + std::to_string(line_number) + " is not name=value";
+            return false;
+        }
+        std::string name = line.substr(0, eq), value = line.substr(eq + 1);
+
+        double number;
+        if (name == "model") {
+            spec.model = value;
+        } else if (name == "design") {
+            if (value == "grid") spec.design = GridDesign;
+            else if (value == "lhs") spec.design = LatinHypercubeDesign;
+            else if (value == "sobol") spec.design = SobolDesign;
+            else {
+                error = "unknown design " + value;
+                return false;
+            }
+        } else if (name == "samples" || name == "seed" || name == "fork_at") {
+            if (!parse_number(value, number) || number < 0) {
+                error = "line " + std::to_string(line_number) + ": " + name + " must be a non-negative number";
+                return false;
+            }
+            if (name == "samples") spec.samples = static_cast<size_t>(number);
+            else if (name == "seed") spec.seed = static_cast<uint64_t>(number);
+            else spec.fork_at = static_cast<int>(number);
+        } else if (value.find(':') != std::string::npos) {
+            ranges.push_back(std::make_pair(name, value));
+        } else if (parse_number(value, number)) {
+            spec.fixed[name] = number;
+        } else {
+            error = "line " + std::to_string(line_number) + ": " + value + " is not a number";
+            return false;
+        }
+    }
+
+    const ModelEntry* model = find_model(spec.model);
+    if (!model) {
+        error = spec.model.empty() ? "no model given" : "unknown model " + spec.model;
+        return false;
+    }
+
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        std::vector<std::string> parts = split_range(ranges[r].second);
+        SweepDimension dim;
+        dim.name = ranges[r].first;
+        dim.levels = 0;
+        dim.integer = false;
+        double levels = 0;
+        bool grid = spec.design == GridDesign;
+        if (parts.size() != (grid ? 3u : 2u) || !parse_number(parts[0], dim.low) || !parse_number(parts[1], dim.high) ||
+            (grid && (!parse_number(parts[2], levels) || levels < 1))) {
+            error = dim.name + ": expected " + (grid ? "low:high:levels" : "low:high");
+            return false;
+        }
+        dim.levels = static_cast<size_t>(levels);
+        spec.dimensions.push_back(dim);
+    }
+
+    // Every name must be in the model's schema, and every value in its range
+    std::vector<std::pair<std::string, double> > values;
+    for (ParameterSet::const_iterator it = spec.fixed.begin(); it != spec.fixed.end(); ++it) values.push_back(*it);
+    for (size_t d = 0; d < spec.dimensions.size(); ++d) {
+        values.push_back(std::make_pair(spec.dimensions[d].name, spec.dimensions[d].low));
+        values.push_back(std::make_pair(spec.dimensions[d].name, spec.dimensions[d].high));
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        const ParameterInfo* field = model->schema->find(values[i].first);
+        if (!field) {
+            error = spec.model + " does not read " + values[i].first + " (it reads: " + model->schema->names() + ")";
+            return false;
+        }
+        if (!check_parameter(*field, values[i].second, error)) return false;
+    }
+    for (size_t d = 0; d < spec.dimensions.size(); ++d) {
+        const ParameterInfo* field = model->schema->find(spec.dimensions[d].name);
+        spec.dimensions[d].integer = field->type != RealParameter;
+        if (spec.fork_at > 0 && (field->flags & StateShape)) {
+            error = spec.dimensions[d].name + " cannot be swept across a fork";
+            return false;
+        }
+        // Every branch runs on from the fork, so none can end before it
+        if (spec.fork_at > 0 && spec.dimensions[d].name == "total_steps" &&
+            std::round(std::min(spec.dimensions[d].low, spec.dimensions[d].high)) < spec.fork_at) {
+            error = "total_steps must be at least fork_at (" + std::to_string(spec.fork_at) + ") in every scenario";
+            return false;
+        }
+    }
+    if (spec.fork_at > 0 && !model->fork) {
+        error = spec.model + " runs cannot fork";
+        return false;
+    }
+
+    if (spec.design != GridDesign && spec.samples == 0) {
+        error = "lhs and sobol designs need samples";
+        return false;
+    }
+    if (spec.design == SobolDesign && spec.dimensions.size() > sobol_max_dimensions) {
+        error = "sobol designs support at most " + std::to_string(sobol_max_dimensions) + " swept parameters";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads shared by the simulators.
+// Work is handed out as numbered blocks; the calling thread also takes blocks and
+// returns once every block of the job has finished.
+class ThreadPool {
+public:
+    // num_threads == 0 uses every hardware thread. The caller counts as one of the threads.
+    explicit ThreadPool(unsigned num_threads = 0)
+        : thread_count(num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency())),
+          generation(0), next_block(0), num_blocks(0), active_workers(0), stopping(false) {
+        for (unsigned t = 1; t < thread_count; ++t) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return thread_count; }
+
+    // Run task(block) for every block in [0, blocks) and wait for all of them
+    void run_blocks(size_t blocks, const std::function<void(size_t)>& task) {
+        if (blocks == 0) return;
+        if (thread_count == 1 || blocks == 1) {
+            for (size_t b = 0; b < blocks; ++b) task(b);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current_task = &task;
+            num_blocks = blocks;
+            next_block.store(0);
+            active_workers = static_cast<unsigned>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+
+        take_blocks(task);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active_workers == 0; });
+        current_task = nullptr;
+    }
+
+    // Split [0, n) into contiguous ranges and run body(begin, end, block) on each.
+    // The split depends only on n and num_blocks, never on the thread count, so
+    // per-block results can be reduced deterministically.
+    template <typename Body>
+    void parallel_for(size_t n, size_t blocks, Body body) {
+        if (n == 0) return;
+        blocks = std::max<size_t>(1, std::min(blocks, n));
+        run_blocks(blocks, [&](size_t b) {
+            body(b * n / blocks, (b + 1) * n / blocks, b);
+        });
+    }
+
+    // Default block count giving each thread several blocks for load balancing
+    size_t default_blocks() const { return static_cast<size_t>(thread_count) * 4; }
+
+private:
+    unsigned thread_count;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* current_task = nullptr;
+    unsigned long long generation;
+    std::atomic<size_t> next_block;
+    size_t num_blocks;
+    unsigned active_workers;
+    bool stopping;
+
+    void take_blocks(const std::function<void(size_t)>& task) {
+        for (size_t b = next_block.fetch_add(1); b < num_blocks; b = next_block.fetch_add(1)) {
+            task(b);
+        }
+    }
+
+    void worker_loop() {
+        unsigned long long seen = 0;
+        for (;;) {
+            const std::function<void(size_t)>* task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = current_task;
+            }
+
+            take_blocks(*task);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active_workers == 0) done.notify_one();
+        }
+    }
+};